@@ -0,0 +1,69 @@
+#pragma once
+
+#include "bench/workload.h"
+#include <getopt.h>
+
+
+typedef struct {
+    WorkloadConfig workload;
+    const char *dist_name;
+    bool real;
+    int quantum;
+    int mlfq[4];
+    const char *predictor;
+    const char *label;
+    const char *out;
+} BenchOptions;
+
+
+/* Parse the command line shared by the benchmark programs, false on a usage error */
+bool parse_bench_options(int argc, char **argv, BenchOptions *opt){
+    opt->workload = default_workload();
+    opt->dist_name = "exponential";
+    opt->real = false;
+    opt->quantum = 20;
+    opt->mlfq[0] = 10; opt->mlfq[1] = 20; opt->mlfq[2] = 40; opt->mlfq[3] = 500;
+    opt->predictor = "mean";
+    opt->label = "current";
+    opt->out = "bench_results.csv";
+
+    struct option options[] = {
+        {"mode", required_argument, 0, 'm'}, {"dist", required_argument, 0, 'd'},
+        {"jobs", required_argument, 0, 'n'}, {"mean", required_argument, 0, 'u'},
+        {"long", required_argument, 0, 'L'}, {"long-fraction", required_argument, 0, 'f'},
+        {"alpha", required_argument, 0, 'a'}, {"load", required_argument, 0, 'l'},
+        {"seed", required_argument, 0, 's'}, {"quantum", required_argument, 0, 'q'},
+        {"mlfq", required_argument, 0, 'M'}, {"label", required_argument, 0, 'b'},
+        {"out", required_argument, 0, 'o'}, {"predictor", required_argument, 0, 'p'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1){
+        switch (c){
+        case 'm': opt->real = strcmp(optarg, "real") == 0; break;
+        case 'd':
+            if (!parse_distribution(optarg, &opt->workload)) return false;
+            opt->dist_name = optarg;
+            break;
+        case 'n': opt->workload.num_jobs = atoi(optarg); break;
+        case 'u': opt->workload.mean_burst = atof(optarg); break;
+        case 'L': opt->workload.long_burst = atof(optarg); break;
+        case 'f': opt->workload.long_fraction = atof(optarg); break;
+        case 'a': opt->workload.pareto_alpha = atof(optarg); break;
+        case 'l': opt->workload.load = atof(optarg); break;
+        case 's': opt->workload.seed = strtoull(optarg, NULL, 10); break;
+        case 'q': opt->quantum = atoi(optarg); break;
+        case 'M':
+            if (sscanf(optarg, "%d,%d,%d,%d", &opt->mlfq[0], &opt->mlfq[1], &opt->mlfq[2], &opt->mlfq[3]) != 4) return false;
+            break;
+        case 'b': opt->label = optarg; break;
+        case 'o': opt->out = optarg; break;
+        case 'p':
+            if (!parse_predictor(optarg, &burst_predictor)) return false;
+            opt->predictor = optarg;
+            break;
+        default: return false;
+        }
+    }
+    return true;
+}
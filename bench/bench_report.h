@@ -0,0 +1,135 @@
+#pragma once
+
+#include "utils.h"
+#include "burst_predictor.h"
+
+
+/* Description of one benchmark run, the metrics are computed from the per-job results */
+typedef struct {
+    const char *label;         // version or configuration being measured
+    const char *scheduler;
+    const char *mode;          // sim or real
+    const char *distribution;
+    const char *predictor;     // burst predictor of the online schedulers
+    PredictionStats *prediction;    // NULL for schedulers that do not predict
+    uint64_t decisions;        // context switches
+    double makespan_ms;        // length of the schedule, virtual time in sim mode
+    double busy_ms;            // time a job was running
+    double overhead_us;        // scheduling overhead per decision
+} BenchRun;
+
+
+int compare_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/* Mean, median and 99th percentile of the values, the array is sorted in place */
+void summarize(uint64_t *values, int n, double *mean, double *p50, double *p99){
+    *mean = *p50 = *p99 = 0;
+    if (n == 0){
+        return;
+    }
+    double sum = 0;
+    for (int i=0; i<n; i++){
+        sum += values[i];
+    }
+    qsort(values, n, sizeof(uint64_t), compare_u64);
+    *mean = sum / n;
+    *p50 = values[(int)(0.50 * (n - 1))];
+    *p99 = values[(int)(0.99 * (n - 1))];
+}
+
+
+/*
+Append one row of metrics to the results csv, writing the header first if the file is empty
+Input:
+    const char *path: results csv
+    BenchRun *run: the run
+    Process results[]: metrics of every job
+    int n: number of jobs
+*/
+void report_run(const char *path, BenchRun *run, Process results[], int n){
+    FILE *out = fopen(path, "a");
+    if (out == NULL){
+        perror(path);
+        return;
+    }
+    if (ftell(out) == 0){
+        fprintf(out, "Label,Scheduler,Mode,Distribution,Jobs,Decisions,Throughput,Overhead Per Decision (us),"
+            "Mean Turnaround,P50 Turnaround,P99 Turnaround,Mean Waiting,P50 Waiting,P99 Waiting,"
+            "Mean Response,P50 Response,P99 Response,CPU Idle Fraction,Predictor,Prediction MAE,Prediction Bias\n");
+    }
+
+    uint64_t *values = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    double turnaround[3], waiting[3], response[3];
+    for (int i=0; i<n; i++) values[i] = results[i].turnaround_time;
+    summarize(values, n, &turnaround[0], &turnaround[1], &turnaround[2]);
+    for (int i=0; i<n; i++) values[i] = results[i].waiting_time;
+    summarize(values, n, &waiting[0], &waiting[1], &waiting[2]);
+    for (int i=0; i<n; i++) values[i] = results[i].response_time;
+    summarize(values, n, &response[0], &response[1], &response[2]);
+    free(values);
+
+    double throughput = run->makespan_ms > 0 ? n / (run->makespan_ms / 1000) : 0;
+    double idle = run->makespan_ms > 0 ? 1 - run->busy_ms / run->makespan_ms : 0;
+    fprintf(out, "%s,%s,%s,%s,%d,%lu,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%s,%.1f,%.1f\n",
+        run->label, run->scheduler, run->mode, run->distribution, n, run->decisions,
+        throughput, run->overhead_us,
+        turnaround[0], turnaround[1], turnaround[2],
+        waiting[0], waiting[1], waiting[2],
+        response[0], response[1], response[2],
+        idle < 0 ? 0 : idle,
+        run->prediction != NULL ? run->predictor : "",
+        run->prediction != NULL ? prediction_mae(run->prediction) : 0,
+        run->prediction != NULL ? prediction_bias(run->prediction) : 0);
+    fclose(out);
+
+    printf("%-6s %-6s %-5s jobs %d, %.1f jobs/s, %.3f us/decision, turnaround p50 %.0f p99 %.0f, waiting mean %.0f, idle %.3f",
+        run->mode, run->scheduler, run->distribution, n, throughput, run->overhead_us,
+        turnaround[1], turnaround[2], waiting[0], idle < 0 ? 0 : idle);
+    if (run->prediction != NULL){
+        printf(", %s mae %.1f", run->predictor, prediction_mae(run->prediction));
+    }
+    printf("\n");
+}
+
+
+static FILE *captured_stdout;
+
+/* Redirect stdout into a temporary file to count context switch lines, returns the saved stdout */
+int capture_stdout_begin(){
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    captured_stdout = tmpfile();
+    dup2(fileno(captured_stdout), STDOUT_FILENO);
+    return saved;
+}
+
+
+/* Restore stdout and return the number of lines written while it was captured */
+uint64_t capture_stdout_end(int saved){
+    fflush(stdout);
+    uint64_t lines = 0;
+    lseek(STDOUT_FILENO, 0, SEEK_SET);
+    char buffer[65536];
+    ssize_t res;
+    while ((res = read(STDOUT_FILENO, buffer, sizeof(buffer))) > 0){
+        for (ssize_t i=0; i<res; i++){
+            lines += buffer[i] == '\n';
+        }
+    }
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    fclose(captured_stdout);
+    return lines;
+}
+
+
+double wall_seconds(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,128 @@
+/*
+Per-decision cost of the simulated offline schedulers on large batches.
+Compares the hot/cold split job table of job_table.h, which the simulator uses, against the
+array of Process records threaded on a JobList it replaced, for Round Robin and MLFQ.
+Every variant runs BENCH_REPEAT times and the fastest run is reported.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. bench/job_table_bench.c -o job_table_bench -lm
+    ./job_table_bench [jobs ...]
+*/
+#include "simulator.h"
+#include "bench/workload.h"
+#include "bench/bench_report.h"
+
+#define BENCH_QUANTUM 10
+#define BENCH_REPEAT 3
+
+
+/* Round Robin on the array of Process records, as the simulator did before the job table */
+SimStats record_round_robin(SimJob jobs[], Process results[], int n, int quantum){
+    SimStats stats;
+    sim_init_results(jobs, results, n, &stats);
+    JobLinks links;
+    job_links_init(&links, n);
+    JobList queue;
+    job_list_init(&queue);
+    for (int i=0; i<n; i++){
+        job_list_push_back(&links, &queue, i);
+    }
+    uint64_t now = 0;
+    int job;
+    while ((job = job_list_pop_front(&links, &queue)) != -1){
+        if (sim_run_slice(&jobs[job], &results[job], &now, quantum, NULL, NULL, &stats) > 0){
+            job_list_push_back(&links, &queue, job);
+        }
+    }
+    job_links_free(&links);
+    return stats;
+}
+
+
+/* MLFQ on the array of Process records, as the simulator did before the job table */
+SimStats record_mlfq(SimJob jobs[], Process results[], int n, int quantum[3], int boostTime){
+    SimStats stats;
+    sim_init_results(jobs, results, n, &stats);
+    JobLinks links;
+    job_links_init(&links, n);
+    MultiLevelQueue queue;
+    mlq_init(&queue, 3);
+    for (int i=0; i<n; i++){
+        job_list_push_back(&links, &queue.level[0], i);
+    }
+    uint64_t now = 0;
+    uint64_t last_boost_time = 0;
+    int level;
+    while (1){
+        if (now - last_boost_time >= (uint64_t)boostTime){
+            mlq_boost(&links, &queue);
+            last_boost_time = now;
+        }
+        int job = mlq_pop_highest(&links, &queue, &level);
+        if (job == -1){
+            break;
+        }
+        if (sim_run_slice(&jobs[job], &results[job], &now, quantum[level], NULL, NULL, &stats) > 0){
+            mlq_demote(&links, &queue, job, level);
+        }
+    }
+    job_links_free(&links);
+    return stats;
+}
+
+
+int main(int argc, char **argv){
+    int sizes[16] = {10000, 100000, 1000000, 2000000};
+    int num_sizes = 4;
+    if (argc > 1){
+        num_sizes = 0;
+        for (int i=1; i<argc && num_sizes<16; i++){
+            sizes[num_sizes++] = atoi(argv[i]);
+        }
+    }
+    int quantum[3] = {BENCH_QUANTUM, 2 * BENCH_QUANTUM, 4 * BENCH_QUANTUM};
+    int boost_time = 100000;
+
+    printf("%10s %12s %18s %18s %10s\n", "jobs", "scheduler", "records ns/dec", "table ns/dec", "speedup");
+    for (int s=0; s<num_sizes; s++){
+        WorkloadConfig cfg = default_workload();
+        cfg.num_jobs = sizes[s];
+        cfg.load = 0;
+        SimJob *jobs;
+        int n = generate_workload(&cfg, &jobs);
+        Process *results = malloc(sizeof(Process) * n);
+
+        for (int policy=0; policy<2; policy++){
+            SimStats before, after;
+            double records_ns = 0, table_ns = 0;
+            for (int r=0; r<BENCH_REPEAT; r++){
+                double start = wall_seconds();
+                before = policy == 0
+                    ? record_round_robin(jobs, results, n, BENCH_QUANTUM)
+                    : record_mlfq(jobs, results, n, quantum, boost_time);
+                double ns = (wall_seconds() - start) * 1e9 / before.decisions;
+                records_ns = r == 0 || ns < records_ns ? ns : records_ns;
+
+                start = wall_seconds();
+                after = policy == 0
+                    ? SimRoundRobin(jobs, results, n, BENCH_QUANTUM, NULL, NULL)
+                    : SimMultiLevelFeedbackQueue(jobs, results, n, quantum[0], quantum[1], quantum[2], boost_time, NULL, NULL);
+                ns = (wall_seconds() - start) * 1e9 / after.decisions;
+                table_ns = r == 0 || ns < table_ns ? ns : table_ns;
+            }
+
+            if (after.decisions != before.decisions || after.makespan != before.makespan){
+                printf("MISMATCH: %lu decisions and makespan %lu against %lu and %lu\n",
+                    after.decisions, after.makespan, before.decisions, before.makespan);
+                return 1;
+            }
+            printf("%10d %12s %18.1f %18.1f %9.2fx\n", n, policy == 0 ? "RR" : "MLFQ", records_ns, table_ns, records_ns / table_ns);
+        }
+
+        for (int i=0; i<n; i++){
+            free(jobs[i].command);
+        }
+        free(jobs);
+        free(results);
+    }
+    return 0;
+}
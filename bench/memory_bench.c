@@ -0,0 +1,146 @@
+/*
+Memory benchmark of a long-running online scheduler: pushes millions of commands through the
+intake thread, the pending queue, the histories and the result writer of the online schedulers,
+and checks that the resident set size stays flat once the scheduler reached its steady state.
+The commands are not executed, each one completes with a burst time derived from its command, so
+every allocation of the scheduling path is exercised without the cost of starting processes.
+90% of the jobs come from a set of 1000 recurring commands and 10% are commands never seen before,
+which keeps the bounded histories evicting.
+Exits with 1 if the RSS grew by more than 5% over the second half of the run, the first half being
+the warm-up in which the histories fill up to their bound and the tables reach their final size.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. bench/memory_bench.c -o memory_bench
+    ./memory_bench [jobs] [max pending jobs]
+*/
+#define MAX_PROCESS_HISTORIES 100000
+#include "online_schedulers.h"
+
+#define RECURRING_COMMANDS 1000
+#define CHECKPOINT_JOBS 1000000
+
+
+typedef struct {
+    uint64_t jobs;
+    uint64_t max_pending;
+    uint64_t completed;    // written by the scheduler loop
+    int fd;
+} Producer;
+
+
+/* Write the commands into the pipe, never more than max_pending ahead of the scheduler */
+void *produce_commands(void *arg){
+    Producer *pr = arg;
+    FILE *out = fdopen(pr->fd, "w");
+    uint64_t rng = 88172645463325252ULL;
+    for (uint64_t i=0; i<pr->jobs; i++){
+        while (i - __atomic_load_n(&pr->completed, __ATOMIC_ACQUIRE) >= pr->max_pending){
+            fflush(out);
+            usleep(100);
+        }
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        if (rng % 10 == 0){
+            fprintf(out, "adhoc-%lu --seed %lu\n", i, rng >> 40);
+        } else {
+            uint64_t k = (rng >> 8) % RECURRING_COMMANDS;
+            fprintf(out, "task-%lu --input data-%lu.bin --threads %lu\n", k, k * 7, k % 8 + 1);
+        }
+    }
+    fclose(out);
+    return NULL;
+}
+
+
+/* Resident set size of this process in MiB */
+double rss_mib(){
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL){
+        fscanf(statm, "%*s %ld", &pages);
+        fclose(statm);
+    }
+    return pages * (double)sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+
+int main(int argc, char **argv){
+    Producer pr = {
+        .jobs = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000,
+        .max_pending = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000,
+        .completed = 0
+    };
+    history_store_path = NULL;
+    int fds[2];
+    pipe(fds);
+    pr.fd = fds[1];
+    pthread_t producer;
+    pthread_create(&producer, NULL, produce_commands, &pr);
+
+    PredictedQueue queue;
+    predicted_queue_init(&queue);
+    uint64_t scheduler_start_time = ms_time(0);
+    FILE *file = fopen("/dev/null", "w");
+    FILE *trace = fopen("/dev/null", "w");
+    ResultWriter writer;
+    writer_start(&writer, file, trace);
+    ArrivalQueue intake;
+    intake_start(&intake, fds[0], scheduler_start_time);
+
+    printf("%12s %10s %10s %12s %10s\n", "jobs", "RSS MiB", "slab MiB", "histories", "pool");
+    double warm_rss = 0;
+    double last_rss = 0;
+    uint64_t completed = 0;
+    while (1){
+        bool input_closed = intake_closed(&intake);
+        predicted_queue_take_arrivals(&queue, &intake);
+        if (queue.heap.size == 0){
+            if (input_closed){
+                break;
+            }
+            intake_wait(&intake);
+            continue;
+        }
+
+        // complete the job as if it ran, releasing what start_process would
+        int job = predicted_queue_pop(&queue);
+        Process *cp = &queue.pool.procs[job];
+        slab_free(cp->args);
+        cp->args = NULL;
+        cp->started = true;
+        cp->finished = true;
+        cp->burst_time = hash_command(cp->command) % 200 + 1;
+        cp->cpu_time = cp->burst_time;
+        cp->completion_time = cp->arrival_time + cp->burst_time;
+        cp->turnaround_time = cp->burst_time;
+        write_result(&writer, cp);
+        context_switch_output(&writer, cp, cp->arrival_time, cp->completion_time);
+        predicted_queue_complete(&queue, job);
+        __atomic_store_n(&pr.completed, ++completed, __ATOMIC_RELEASE);
+
+        if (completed % CHECKPOINT_JOBS == 0){
+            last_rss = rss_mib();
+            if (completed == pr.jobs / 2 / CHECKPOINT_JOBS * CHECKPOINT_JOBS){
+                warm_rss = last_rss;
+            }
+            printf("%12lu %10.1f %10.1f %12d %10d\n", completed, last_rss, slab_footprint() / (1024.0 * 1024),
+                queue.histories.size, queue.pool.capacity);
+            fflush(stdout);
+        }
+    }
+
+    intake_stop(&intake);
+    job_output_stop();
+    writer_stop(&writer);
+    fclose(file);
+    fclose(trace);
+    pthread_join(producer, NULL);
+    predicted_queue_free(&queue);
+
+    if (warm_rss > 0 && last_rss > warm_rss * 1.05){
+        printf("FAIL: RSS grew from %.1f MiB to %.1f MiB over the second half\n", warm_rss, last_rss);
+        return 1;
+    }
+    printf("OK: RSS %.1f MiB at half of the jobs, %.1f MiB at the end\n", warm_rss, last_rss);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+Online scheduler benchmark: replays a workload into the real online schedulers through their stdin,
+submitting every command at its arrival time, and appends one row of metrics per scheduler to the
+results csv (same format as bench/sched_bench.c).
+Build and run from the repository root:
+    gcc -O2 -pthread -I. bench/online_bench.c -o online_bench -lm
+    ./online_bench --jobs 30 --mean 30 --load 0.8
+Options are the same as bench/sched_bench.c, --mode is ignored.
+*/
+#include "online_schedulers.h"
+#include "bench/workload.h"
+#include "bench/bench_report.h"
+#include "bench/bench_options.h"
+
+
+typedef struct {
+    SimJob *jobs;
+    int n;
+    int fd;
+} Feeder;
+
+
+/* Write every command into the pipe at its arrival time, then close it */
+void *feed_commands(void *arg){
+    Feeder *f = arg;
+    uint64_t start = ms_time(0);
+    for (int i=0; i<f->n; i++){
+        uint64_t now = ms_time(start);
+        if (f->jobs[i].arrival_time > now){
+            usleep((f->jobs[i].arrival_time - now) * 1000);
+        }
+        dprintf(f->fd, "%s\n", f->jobs[i].command);
+    }
+    close(f->fd);
+    return NULL;
+}
+
+
+/* Read the rows of a result csv back into process records, returns the number of rows */
+int read_results(const char *path, Process results[], int n){
+    FILE *file = fopen(path, "r");
+    if (file == NULL){
+        return 0;
+    }
+    char line[1200];
+    int rows = 0;
+    fgets(line, sizeof(line), file);
+    while (rows < n && fgets(line, sizeof(line), file) != NULL){
+        // the command may contain commas, the 7 metric columns are taken from the end
+        char *fields[7];
+        for (int k=6; k>=0; k--){
+            char *comma = strrchr(line, ',');
+            if (comma == NULL){
+                break;
+            }
+            *comma = '\0';
+            fields[k] = comma + 1;
+        }
+        Process *p = &results[rows++];
+        memset(p, 0, sizeof(Process));
+        p->finished = strcmp(fields[0], "Yes") == 0;
+        p->error = strcmp(fields[1], "Yes") == 0;
+        p->burst_time = strtoull(fields[2], NULL, 10);
+        p->turnaround_time = strtoull(fields[3], NULL, 10);
+        p->waiting_time = strtoull(fields[4], NULL, 10);
+        p->response_time = strtoull(fields[5], NULL, 10);
+        p->cpu_time = strtoull(fields[6], NULL, 10);
+    }
+    fclose(file);
+    return rows;
+}
+
+
+int main(int argc, char **argv){
+    BenchOptions opt;
+    if (!parse_bench_options(argc, argv, &opt)){
+        fprintf(stderr, "usage: see the header of bench/sched_bench.c\n");
+        return 1;
+    }
+    SimJob *jobs;
+    int n = generate_workload(&opt.workload, &jobs);
+    Process *results = malloc(sizeof(Process) * n);
+    const char *names[] = {"SJF", "MLFQ-online", "SRTF"};
+    const char *paths[] = {"result_online_SJF.csv", "result_online_MLFQ.csv", "result_online_SRTF.csv"};
+    int saved_stdin = dup(STDIN_FILENO);
+    // every scheduler starts cold, as in the simulator
+    history_store_path = NULL;
+
+    for (int s=0; s<3; s++){
+        int fds[2];
+        pipe(fds);
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        Feeder feeder = {.jobs = jobs, .n = n, .fd = fds[1]};
+        pthread_t thread;
+        pthread_create(&thread, NULL, feed_commands, &feeder);
+
+        int saved = capture_stdout_begin();
+        double start = wall_seconds();
+        switch (s){
+        case 0: ShortestJobFirst(); break;
+        case 1: MultiLevelFeedbackQueue(opt.mlfq[0], opt.mlfq[1], opt.mlfq[2], opt.mlfq[3]); break;
+        default: ShortestRemainingTimeFirst();
+        }
+        double elapsed_ms = (wall_seconds() - start) * 1000;
+        uint64_t decisions = capture_stdout_end(saved);
+        pthread_join(thread, NULL);
+
+        int rows = read_results(paths[s], results, n);
+        BenchRun run = {.label = opt.label, .scheduler = names[s], .mode = "real", .distribution = opt.dist_name, .decisions = decisions};
+        run.predictor = opt.predictor;
+        run.prediction = &online_prediction_stats;
+        run.makespan_ms = elapsed_ms;
+        for (int i=0; i<rows; i++){
+            run.busy_ms += results[i].burst_time;
+        }
+        // idle time waiting for arrivals is not overhead, the estimate only counts wall time beyond the bursts
+        run.overhead_us = decisions > 0 && elapsed_ms > run.busy_ms ? (elapsed_ms - run.busy_ms) * 1000 / decisions : 0;
+        report_run(opt.out, &run, results, rows);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+Per-decision overhead of the MLFQ run queues with a deep backlog.
+Compares the intrusive run queues of run_queue.h against the array shifting queues they replaced.
+Build and run from the repository root:
+    gcc -O2 -I. bench/run_queue_bench.c -o run_queue_bench && ./run_queue_bench
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "run_queue.h"
+
+#define BOOST_EVERY 1000
+
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+/* xorshift64, enough randomness to decide between completion and demotion */
+uint64_t next_random(){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+
+uint64_t ns_time(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*
+Run decisions on the intrusive queues: take the highest priority job, then complete it
+(replacing it with a new arrival so the depth stays constant) or demote it, boosting periodically
+Output: nanoseconds per decision
+*/
+double bench_intrusive(int depth, int decisions){
+    JobLinks links;
+    job_links_init(&links, depth);
+    MultiLevelQueue q;
+    mlq_init(&q, 3);
+    for (int i=0; i<depth; i++){
+        job_list_push_back(&links, &q.level[0], i);
+    }
+
+    uint64_t start = ns_time();
+    for (int d=0; d<decisions; d++){
+        if (d % BOOST_EVERY == 0){
+            mlq_boost(&links, &q);
+        }
+        int level;
+        int job = mlq_pop_highest(&links, &q, &level);
+        if (next_random() % 4 == 0){
+            job_list_push_back(&links, &q.level[0], job);
+        } else {
+            mlq_demote(&links, &q, job, level);
+        }
+    }
+    uint64_t elapsed = ns_time() - start;
+
+    job_links_free(&links);
+    return (double)elapsed / decisions;
+}
+
+
+/* Same decisions on the previous array queues, removal and boost shift or copy every entry */
+double bench_array(int depth, int decisions){
+    int *queue[3];
+    int size[3] = {depth, 0, 0};
+    for (int l=0; l<3; l++){
+        queue[l] = malloc(sizeof(int) * depth);
+    }
+    for (int i=0; i<depth; i++){
+        queue[0][i] = i;
+    }
+
+    uint64_t start = ns_time();
+    for (int d=0; d<decisions; d++){
+        if (d % BOOST_EVERY == 0){
+            for (int l=1; l<3; l++){
+                for (int j=0; j<size[l]; j++){
+                    queue[0][size[0]++] = queue[l][j];
+                }
+                size[l] = 0;
+            }
+        }
+        int level = size[0] > 0 ? 0 : (size[1] > 0 ? 1 : 2);
+        int job = queue[level][0];
+        memmove(queue[level], queue[level]+1, sizeof(int) * (size[level]-1));
+        size[level]--;
+        int target = next_random() % 4 == 0 ? 0 : (level < 2 ? level+1 : 2);
+        queue[target][size[target]++] = job;
+    }
+    uint64_t elapsed = ns_time() - start;
+
+    for (int l=0; l<3; l++){
+        free(queue[l]);
+    }
+    return (double)elapsed / decisions;
+}
+
+
+int main(){
+    int depths[] = {10000, 100000, 1000000};
+    printf("%-10s %-12s %-18s %-18s\n", "jobs", "decisions", "intrusive ns/dec", "array ns/dec");
+    for (int i=0; i<3; i++){
+        int depth = depths[i];
+        int decisions = 2000000;
+        // the array queues are O(depth) per decision, keep their run time bounded
+        int array_decisions = (int)(200000000LL / depth);
+        double intrusive = bench_intrusive(depth, decisions);
+        double array = bench_array(depth, array_decisions);
+        printf("%-10d %-12d %-18.1f %-18.1f\n", depth, decisions, intrusive, array);
+    }
+    return 0;
+}
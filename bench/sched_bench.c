@@ -0,0 +1,124 @@
+/*
+Scheduler benchmark: generates a workload and runs it through the schedulers, appending one row
+of metrics per scheduler to a results csv so that versions can be compared.
+sim mode runs every policy in the simulator, real mode runs the offline schedulers on real processes
+(bench/online_bench.c covers the real online schedulers).
+Build and run from the repository root:
+    gcc -O2 -pthread -I. bench/sched_bench.c -o sched_bench -lm
+    ./sched_bench --mode sim --dist heavy-tailed --jobs 1000000
+    ./sched_bench --mode real --jobs 20 --mean 30
+Options:
+    --mode sim|real                 default sim
+    --dist exponential|bimodal|heavy-tailed|replay:<file>
+    --jobs N --mean MS --long MS --long-fraction F --alpha A --load L --seed S
+    --quantum MS                    Round Robin time slice
+    --mlfq Q0,Q1,Q2,BOOST           MLFQ time slices and boost time
+    --predictor SPEC                burst predictor of the online policies, see parse_predictor
+                                    (mean, ema:0.3, percentile:16:0.5, any of them +prefix)
+    --label NAME --out FILE         row label and results csv (bench_results.csv)
+*/
+#include "offline_schedulers.h"
+#include "bench/workload.h"
+#include "bench/bench_report.h"
+#include "bench/bench_options.h"
+
+
+/* Copy of the workload with every arrival at time 0, as the offline schedulers assume */
+SimJob *offline_copy(SimJob jobs[], int n){
+    SimJob *offline = malloc(sizeof(SimJob) * n);
+    for (int i=0; i<n; i++){
+        offline[i] = jobs[i];
+        offline[i].arrival_time = 0;
+    }
+    return offline;
+}
+
+
+/* Fill in the schedule length and cpu busy time of a run from its results */
+void measure_schedule(BenchRun *run, Process results[], int n){
+    run->makespan_ms = 0;
+    run->busy_ms = 0;
+    for (int i=0; i<n; i++){
+        if (results[i].completion_time > run->makespan_ms){
+            run->makespan_ms = results[i].completion_time;
+        }
+        run->busy_ms += results[i].burst_time;
+    }
+}
+
+
+void run_simulated(BenchOptions *opt, SimJob jobs[], int n){
+    SimJob *offline = offline_copy(jobs, n);
+    Process *results = malloc(sizeof(Process) * n);
+    const char *names[] = {"FCFS", "RR", "MLFQ", "SJF", "MLFQ-online"};
+
+    for (int s=0; s<5; s++){
+        double start = wall_seconds();
+        SimStats stats;
+        switch (s){
+        case 0: stats = SimFCFS(offline, results, n, NULL, NULL); break;
+        case 1: stats = SimRoundRobin(offline, results, n, opt->quantum, NULL, NULL); break;
+        case 2: stats = SimMultiLevelFeedbackQueue(offline, results, n, opt->mlfq[0], opt->mlfq[1], opt->mlfq[2], opt->mlfq[3], NULL, NULL); break;
+        case 3: stats = SimShortestJobFirst(jobs, results, n, NULL, NULL); break;
+        default: stats = SimOnlineMultiLevelFeedbackQueue(jobs, results, n, opt->mlfq[0], opt->mlfq[1], opt->mlfq[2], opt->mlfq[3], NULL, NULL);
+        }
+        double elapsed = wall_seconds() - start;
+
+        BenchRun run = {
+            .label = opt->label, .scheduler = names[s], .mode = "sim", .distribution = opt->dist_name,
+            .decisions = stats.decisions,
+            .makespan_ms = stats.makespan, .busy_ms = stats.busy_time,
+            .overhead_us = stats.decisions > 0 ? elapsed * 1e6 / stats.decisions : 0,
+            .predictor = opt->predictor, .prediction = s >= 3 ? &stats.prediction : NULL
+        };
+        report_run(opt->out, &run, results, n);
+    }
+    free(offline);
+    free(results);
+}
+
+
+void run_real(BenchOptions *opt, SimJob jobs[], int n){
+    Process *p = malloc(sizeof(Process) * n);
+    const char *names[] = {"FCFS", "RR", "MLFQ"};
+
+    for (int s=0; s<3; s++){
+        for (int i=0; i<n; i++){
+            memset(&p[i], 0, sizeof(Process));
+            p[i].command = jobs[i].command;
+        }
+        int saved = capture_stdout_begin();
+        double start = wall_seconds();
+        switch (s){
+        case 0: FCFS(p, n); break;
+        case 1: RoundRobin(p, n, opt->quantum); break;
+        default: MultiLevelFeedbackQueue(p, n, opt->mlfq[0], opt->mlfq[1], opt->mlfq[2], opt->mlfq[3]);
+        }
+        double elapsed_ms = (wall_seconds() - start) * 1000;
+        uint64_t decisions = capture_stdout_end(saved);
+
+        BenchRun run = {.label = opt->label, .scheduler = names[s], .mode = "real", .distribution = opt->dist_name, .decisions = decisions};
+        measure_schedule(&run, p, n);
+        // wall time not spent inside a job is the cost of the scheduler
+        run.overhead_us = decisions > 0 && elapsed_ms > run.busy_ms ? (elapsed_ms - run.busy_ms) * 1000 / decisions : 0;
+        report_run(opt->out, &run, p, n);
+    }
+    free(p);
+}
+
+
+int main(int argc, char **argv){
+    BenchOptions opt;
+    if (!parse_bench_options(argc, argv, &opt)){
+        fprintf(stderr, "usage: see the header of bench/sched_bench.c\n");
+        return 1;
+    }
+    SimJob *jobs;
+    int n = generate_workload(&opt.workload, &jobs);
+    if (opt.real){
+        run_real(&opt, jobs, n);
+    } else {
+        run_simulated(&opt, jobs, n);
+    }
+    return 0;
+}
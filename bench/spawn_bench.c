@@ -0,0 +1,67 @@
+/*
+Job start benchmark: latency of starting a process with fork + exec, as the schedulers used to,
+and with start_process (posix_spawnp), while the scheduler holds a growing amount of touched heap.
+fork copies the page tables of the parent, so its cost grows with the resident memory of the
+scheduler; posix_spawnp does not. The latency is the time until the start call returns: fork
+returns before the child execs, posix_spawnp only once the exec succeeded.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. bench/spawn_bench.c -o spawn_bench
+    ./spawn_bench [starts per size] [largest heap in MiB]
+*/
+#include "utils.h"
+
+
+/* Start the command with fork, tokenizing it in the child, the previous start path */
+pid_t fork_start(char *command){
+    pid_t pid = fork();
+    if (pid == 0){
+        char **args = tokenize_command(command);
+        execvp(args[0], args);
+        _exit(1);
+    }
+    return pid;
+}
+
+
+/* Mean latency in microseconds of starting the command, the child is reaped outside the timed part */
+double start_latency(char *command, int starts, bool spawn){
+    uint64_t total_ns = 0;
+    for (int i=0; i<starts; i++){
+        Process p = {0};
+        p.command = command;
+        struct timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (spawn){
+            start_process(&p, 0);
+        } else {
+            p.process_id = fork_start(command);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total_ns += (end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec;
+        waitpid(p.process_id, NULL, 0);
+        if (p.pidfd >= 0){
+            close(p.pidfd);
+        }
+    }
+    return total_ns / 1000.0 / starts;
+}
+
+
+int main(int argc, char **argv){
+    int starts = argc > 1 ? atoi(argv[1]) : 200;
+    size_t max_mib = argc > 2 ? strtoull(argv[2], NULL, 10) : 1024;
+    char command[] = "true";
+
+    printf("%10s %14s %14s\n", "heap MiB", "fork+exec us", "spawn us");
+    char *heap = NULL;
+    for (size_t mib=0; mib<=max_mib; mib = mib == 0 ? 64 : mib * 2){
+        // touch every page so that it is resident and mapped in the page tables
+        heap = realloc(heap, mib * 1024 * 1024 + 1);
+        memset(heap, 1, mib * 1024 * 1024 + 1);
+        double fork_us = start_latency(command, starts, false);
+        double spawn_us = start_latency(command, starts, true);
+        printf("%10zu %14.1f %14.1f\n", mib, fork_us, spawn_us);
+    }
+    free(heap);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <math.h>
+#include "simulator.h"
+
+
+/*
+Synthetic and replayed workloads for the benchmarks.
+Every job runs "sleep <burst>", so the same workload can drive the real schedulers and the
+simulator, and commands with equal bursts share a history in the online schedulers.
+*/
+
+typedef enum {
+    DIST_EXPONENTIAL,
+    DIST_BIMODAL,
+    DIST_HEAVY_TAILED,
+    DIST_REPLAY
+} BurstDistribution;
+
+
+typedef struct {
+    BurstDistribution dist;
+    int num_jobs;
+    double mean_burst;    // ms, mean of the exponential and of the short mode of the bimodal distribution
+    double long_burst;    // ms, long mode of the bimodal distribution
+    double long_fraction; // share of long jobs in the bimodal distribution
+    double pareto_alpha;  // shape of the heavy-tailed (Pareto) distribution
+    double load;          // offered cpu load for online arrivals, 0 puts every arrival at time 0
+    const char *replay_path;  // "arrival,burst,command" lines for DIST_REPLAY
+    uint64_t seed;
+} WorkloadConfig;
+
+
+static uint64_t workload_rng;
+
+/* Uniform double in (0, 1), splitmix64 */
+double uniform_random(){
+    uint64_t z = (workload_rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return ((z >> 11) + 0.5) / 9007199254740992.0;
+}
+
+
+double exponential_random(double mean){
+    return -mean * log(uniform_random());
+}
+
+
+/* Draw one burst time in ms from the configured distribution, at least 1 ms */
+uint64_t draw_burst(WorkloadConfig *cfg){
+    double burst;
+    switch (cfg->dist){
+    case DIST_BIMODAL:
+        burst = uniform_random() < cfg->long_fraction
+            ? exponential_random(cfg->long_burst)
+            : exponential_random(cfg->mean_burst);
+        break;
+    case DIST_HEAVY_TAILED: {
+        // Pareto with the configured mean, x_m = mean * (alpha - 1) / alpha
+        double xm = cfg->mean_burst * (cfg->pareto_alpha - 1) / cfg->pareto_alpha;
+        burst = xm / pow(uniform_random(), 1.0 / cfg->pareto_alpha);
+        break;
+    }
+    default:
+        burst = exponential_random(cfg->mean_burst);
+    }
+    return burst < 1 ? 1 : (uint64_t)burst;
+}
+
+
+/* Command that runs for the given burst time */
+char *sleep_command(uint64_t burst){
+    char command[64];
+    snprintf(command, sizeof(command), "sleep %lu.%03lu", burst / 1000, burst % 1000);
+    return strdup(command);
+}
+
+
+/* Read a recorded workload, returns the number of jobs read */
+int read_replay(const char *path, SimJob **jobs){
+    FILE *file = fopen(path, "r");
+    if (file == NULL){
+        perror(path);
+        return 0;
+    }
+    int capacity = 1024;
+    int n = 0;
+    *jobs = malloc(sizeof(SimJob) * capacity);
+    char line[1100];
+    while (fgets(line, sizeof(line), file) != NULL){
+        uint64_t arrival, burst;
+        int offset;
+        if (sscanf(line, "%lu,%lu,%n", &arrival, &burst, &offset) != 2){
+            continue;
+        }
+        char *command = line + offset;
+        command[strcspn(command, "\r\n")] = '\0';
+        if (n >= capacity){
+            capacity *= 2;
+            *jobs = realloc(*jobs, sizeof(SimJob) * capacity);
+        }
+        (*jobs)[n].arrival_time = arrival;
+        (*jobs)[n].service_time = burst;
+        (*jobs)[n].command = *command ? strdup(command) : sleep_command(burst);
+        (*jobs)[n].fails = false;
+        n++;
+    }
+    fclose(file);
+    return n;
+}
+
+
+/*
+Generate a workload
+Input:
+    WorkloadConfig *cfg: distribution and size
+    SimJob **jobs: set to the generated jobs, sorted by arrival time
+Output: number of jobs
+*/
+int generate_workload(WorkloadConfig *cfg, SimJob **jobs){
+    if (cfg->dist == DIST_REPLAY){
+        return read_replay(cfg->replay_path, jobs);
+    }
+    workload_rng = cfg->seed;
+    *jobs = malloc(sizeof(SimJob) * cfg->num_jobs);
+
+    uint64_t *bursts = malloc(sizeof(uint64_t) * cfg->num_jobs);
+    double total = 0;
+    for (int i=0; i<cfg->num_jobs; i++){
+        bursts[i] = draw_burst(cfg);
+        total += bursts[i];
+    }
+
+    // Poisson arrivals at the rate that offers the configured load
+    double mean_interarrival = cfg->load > 0 ? total / cfg->num_jobs / cfg->load : 0;
+    double arrival = 0;
+    for (int i=0; i<cfg->num_jobs; i++){
+        if (i > 0 && mean_interarrival > 0){
+            arrival += exponential_random(mean_interarrival);
+        }
+        (*jobs)[i].arrival_time = (uint64_t)arrival;
+        (*jobs)[i].service_time = bursts[i];
+        (*jobs)[i].command = sleep_command(bursts[i]);
+        (*jobs)[i].fails = false;
+    }
+    free(bursts);
+    return cfg->num_jobs;
+}
+
+
+/* Parse a distribution name, replay:<path> reads a recorded workload */
+bool parse_distribution(const char *name, WorkloadConfig *cfg){
+    if (strcmp(name, "exponential") == 0){
+        cfg->dist = DIST_EXPONENTIAL;
+    } else if (strcmp(name, "bimodal") == 0){
+        cfg->dist = DIST_BIMODAL;
+    } else if (strcmp(name, "heavy-tailed") == 0){
+        cfg->dist = DIST_HEAVY_TAILED;
+    } else if (strncmp(name, "replay:", 7) == 0){
+        cfg->dist = DIST_REPLAY;
+        cfg->replay_path = name + 7;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+/* Default workload: 1000 exponential jobs with a 50 ms mean */
+WorkloadConfig default_workload(){
+    WorkloadConfig cfg = {
+        .dist = DIST_EXPONENTIAL,
+        .num_jobs = 1000,
+        .mean_burst = 50,
+        .long_burst = 1000,
+        .long_fraction = 0.1,
+        .pareto_alpha = 1.5,
+        .load = 0.9,
+        .replay_path = NULL,
+        .seed = 1
+    };
+    return cfg;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define PREDICTOR_DEFAULT_BURST_TIME 1000
+#define PREDICTOR_MAX_WINDOW 64
+
+
+/*
+Burst time predictors of the online schedulers.
+Every command keeps a BurstModel that is fed the burst time of each of its completed processes,
+the configured predictor turns it into the prediction used to order and classify new processes.
+*/
+typedef enum {
+    PREDICT_MEAN,          // mean of every burst seen so far
+    PREDICT_EMA,           // exponential average, reacts to shifts in the behavior of a command
+    PREDICT_PERCENTILE     // percentile of the most recent bursts, robust to outliers
+} PredictorKind;
+
+
+typedef struct {
+    PredictorKind kind;
+    double alpha;          // EMA: weight of the newest burst, in (0, 1]
+    int window;            // PERCENTILE: number of recent bursts kept
+    double percentile;     // PERCENTILE: in [0, 1], 0.5 for the median
+    bool prefix_cold_start;    // predict a new command from other commands running the same program
+    uint64_t default_burst_time;    // prediction for a command with no history at all
+} PredictorConfig;
+
+
+/* Per-command state of the predictor */
+typedef struct {
+    double estimate;       // MEAN and EMA: current estimate
+    uint64_t count;        // bursts recorded
+    uint64_t *window;      // PERCENTILE: ring of the most recent bursts, allocated on the first record
+} BurstModel;
+
+
+/* Error of the predictions checked against the burst time that followed them */
+typedef struct {
+    uint64_t predictions;
+    double error;          // sum of predicted - actual, the bias
+    double abs_error;
+    double squared_error;
+} PredictionStats;
+
+
+// predictor used by the online schedulers and their simulations, set it before starting them
+static PredictorConfig burst_predictor = {
+    .kind = PREDICT_MEAN,
+    .alpha = 0.5,
+    .window = 16,
+    .percentile = 0.5,
+    .prefix_cold_start = false,
+    .default_burst_time = PREDICTOR_DEFAULT_BURST_TIME
+};
+
+
+void burst_model_init(BurstModel *m){
+    m->estimate = 0;
+    m->count = 0;
+    m->window = NULL;
+}
+
+
+void burst_model_free(BurstModel *m){
+    free(m->window);
+    m->window = NULL;
+}
+
+
+/*
+Predict the next burst time of a command
+Input:
+    BurstModel *m: model of the command
+    PredictorConfig *cfg: the predictor
+    uint64_t cold_start: prediction to use while the model has no bursts
+Output:
+    predicted burst time in milliseconds
+*/
+uint64_t burst_model_predict(BurstModel *m, PredictorConfig *cfg, uint64_t cold_start){
+    if (m->count == 0){
+        return cold_start;
+    }
+    if (cfg->kind != PREDICT_PERCENTILE){
+        return (uint64_t)(m->estimate + 0.5);
+    }
+
+    // insertion sort of the window, it holds at most PREDICTOR_MAX_WINDOW bursts
+    int n = m->count < (uint64_t)cfg->window ? (int)m->count : cfg->window;
+    uint64_t sorted[PREDICTOR_MAX_WINDOW];
+    for (int i=0; i<n; i++){
+        uint64_t burst = m->window[i];
+        int j = i;
+        while (j > 0 && sorted[j-1] > burst){
+            sorted[j] = sorted[j-1];
+            j--;
+        }
+        sorted[j] = burst;
+    }
+    return sorted[(int)(cfg->percentile * (n - 1) + 0.5)];
+}
+
+
+/* Feed the burst time of a completed process into the model of its command */
+void burst_model_record(BurstModel *m, PredictorConfig *cfg, uint64_t burst_time){
+    switch (cfg->kind){
+    case PREDICT_EMA:
+        m->estimate = m->count == 0 ? burst_time : m->estimate + cfg->alpha * (burst_time - m->estimate);
+        break;
+    case PREDICT_PERCENTILE:
+        if (m->window == NULL){
+            m->window = malloc(sizeof(uint64_t) * cfg->window);
+        }
+        m->window[m->count % cfg->window] = burst_time;
+        break;
+    default:
+        // incremental mean in floating point, the sum of the bursts is never formed so it cannot overflow
+        m->estimate += (burst_time - m->estimate) / (m->count + 1);
+    }
+    m->count++;
+}
+
+
+void prediction_stats_add(PredictionStats *s, uint64_t predicted, uint64_t actual){
+    double error = (double)predicted - (double)actual;
+    s->predictions++;
+    s->error += error;
+    s->abs_error += error < 0 ? -error : error;
+    s->squared_error += error * error;
+}
+
+
+/* Mean absolute error of the predictions, 0 if none were checked */
+double prediction_mae(PredictionStats *s){
+    return s->predictions > 0 ? s->abs_error / s->predictions : 0;
+}
+
+
+/* Mean of predicted - actual, positive when the predictor overestimates */
+double prediction_bias(PredictionStats *s){
+    return s->predictions > 0 ? s->error / s->predictions : 0;
+}
+
+
+/* Print a summary of the prediction errors */
+void prediction_stats_print(FILE *stream, PredictionStats *s){
+    double mse = s->predictions > 0 ? s->squared_error / s->predictions : 0;
+    fprintf(stream, "predictions %lu, mean abs error %.1f ms, bias %.1f ms, mean squared error %.1f\n",
+        s->predictions, prediction_mae(s), prediction_bias(s), mse);
+}
+
+
+/*
+Parse a predictor description: mean, ema[:alpha] or percentile[:window[:percentile]],
+followed by +prefix to predict new commands from their program name
+Input:
+    const char *spec: the description
+    PredictorConfig *cfg: updated with the parsed fields
+Output:
+    false if the description is invalid
+*/
+bool parse_predictor(const char *spec, PredictorConfig *cfg){
+    char kind[32];
+    int len = strcspn(spec, ":+");
+    if (len >= (int)sizeof(kind)){
+        return false;
+    }
+    memcpy(kind, spec, len);
+    kind[len] = '\0';
+    const char *params = spec[len] == ':' ? spec + len + 1 : "";
+    cfg->prefix_cold_start = strstr(spec, "+prefix") != NULL;
+
+    if (strcmp(kind, "mean") == 0){
+        cfg->kind = PREDICT_MEAN;
+    } else if (strcmp(kind, "ema") == 0){
+        cfg->kind = PREDICT_EMA;
+        if (*params && *params != '+'){
+            cfg->alpha = atof(params);
+        }
+        if (cfg->alpha <= 0 || cfg->alpha > 1){
+            return false;
+        }
+    } else if (strcmp(kind, "percentile") == 0){
+        cfg->kind = PREDICT_PERCENTILE;
+        if (*params && *params != '+'){
+            cfg->window = atoi(params);
+            const char *pct = strchr(params, ':');
+            if (pct != NULL){
+                cfg->percentile = atof(pct + 1);
+            }
+        }
+        if (cfg->window < 1 || cfg->window > PREDICTOR_MAX_WINDOW || cfg->percentile < 0 || cfg->percentile > 1){
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
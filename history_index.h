@@ -0,0 +1,469 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "burst_predictor.h"
+#include "history_store.h"
+#include "slab.h"
+
+#define HISTORY_EMPTY -1
+#define HISTORY_TOMBSTONE -2
+#define HISTORY_MIGRATE_STEP 8
+#define HISTORY_MAX_PREFIX 256
+
+
+typedef struct {
+    char *command;
+    uint64_t predicted_burst_time;
+    BurstModel model;
+    uint64_t hash;
+    int refs;        // pending processes using this history, pinned entries are never evicted
+    int lru_prev;
+    int lru_next;
+} ProcessHistory;
+
+
+/*
+Open addressing hash index from interned command strings to ProcessHistory slots.
+Slots keep their index for as long as the entry lives, so processes store the slot index.
+Growing the table is incremental: the previous table is kept and a few of its buckets are
+moved on every operation until it is empty. With max_entries set, inserting into a full index
+evicts the least recently used entry that no pending process refers to.
+With prefix cold start, a second index keyed by program name learns from every burst recorded
+here and gives the first prediction of commands that were never seen.
+With a store attached, every change of a history is mirrored into the record of its slot.
+*/
+typedef struct HistoryIndex {
+    ProcessHistory *entries;
+    int num_entries;
+    int capacity;
+    int *free_slots;
+    int num_free;
+
+    int *table;
+    uint64_t table_mask;
+    int table_used;    // live entries and tombstones in table
+    int *old_table;    // table being migrated, NULL when no resize is in progress
+    uint64_t old_mask;
+    uint64_t migrate_pos;
+
+    int lru_head;    // most recently used
+    int lru_tail;    // least recently used
+    int size;
+    int max_entries;    // 0 for an unbounded index
+
+    PredictorConfig predictor;
+    PredictionStats stats;
+    struct HistoryIndex *prefixes;    // NULL without prefix cold start
+    HistoryStore *store;    // NULL when the histories are not persisted
+} HistoryIndex;
+
+
+/* FNV-1a hash of the command string */
+uint64_t hash_command(const char *command){
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)command; *c; c++){
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+int *new_history_table(uint64_t buckets){
+    int *table = malloc(sizeof(int) * buckets);
+    for (uint64_t i=0; i<buckets; i++){
+        table[i] = HISTORY_EMPTY;
+    }
+    return table;
+}
+
+
+/*
+Initialise an empty index
+Input:
+    HistoryIndex *h: the index
+    int max_entries: maximum number of histories kept, 0 for no bound
+    PredictorConfig *predictor: predictor of the burst times
+*/
+void history_index_init(HistoryIndex *h, int max_entries, PredictorConfig *predictor){
+    h->capacity = 64;
+    h->entries = malloc(sizeof(ProcessHistory) * h->capacity);
+    h->free_slots = malloc(sizeof(int) * h->capacity);
+    h->num_entries = 0;
+    h->num_free = 0;
+    h->table_mask = 127;
+    h->table = new_history_table(h->table_mask + 1);
+    h->table_used = 0;
+    h->old_table = NULL;
+    h->old_mask = 0;
+    h->migrate_pos = 0;
+    h->lru_head = -1;
+    h->lru_tail = -1;
+    h->size = 0;
+    h->max_entries = max_entries;
+    h->predictor = *predictor;
+    memset(&h->stats, 0, sizeof(PredictionStats));
+    h->prefixes = NULL;
+    h->store = NULL;
+    if (predictor->prefix_cold_start){
+        PredictorConfig prefix_predictor = *predictor;
+        prefix_predictor.prefix_cold_start = false;
+        h->prefixes = malloc(sizeof(HistoryIndex));
+        history_index_init(h->prefixes, max_entries, &prefix_predictor);
+    }
+}
+
+
+/* Size an empty index for the given number of histories, so that loading them does not resize it */
+void history_index_reserve(HistoryIndex *h, int num_entries){
+    if (h->size > 0 || num_entries <= h->capacity){
+        return;
+    }
+    h->capacity = num_entries;
+    h->entries = realloc(h->entries, sizeof(ProcessHistory) * h->capacity);
+    h->free_slots = realloc(h->free_slots, sizeof(int) * h->capacity);
+    uint64_t buckets = h->table_mask + 1;
+    while (buckets * 7 <= (uint64_t)num_entries * 10){
+        buckets *= 2;
+    }
+    free(h->table);
+    h->table = new_history_table(buckets);
+    h->table_mask = buckets - 1;
+}
+
+
+/* Get the history stored in the given slot */
+ProcessHistory *history_at(HistoryIndex *h, int slot){
+    return &h->entries[slot];
+}
+
+
+/* Place a slot in the current table, the key must not be present yet */
+void history_table_put(HistoryIndex *h, int slot){
+    uint64_t i = h->entries[slot].hash & h->table_mask;
+    while (h->table[i] >= 0){
+        i = (i + 1) & h->table_mask;
+    }
+    if (h->table[i] == HISTORY_EMPTY){
+        h->table_used++;
+    }
+    h->table[i] = slot;
+}
+
+
+/* Move up to the given number of buckets from the old table into the current one */
+void history_migrate(HistoryIndex *h, uint64_t buckets){
+    if (h->old_table == NULL){
+        return;
+    }
+    while (buckets-- > 0 && h->migrate_pos <= h->old_mask){
+        int slot = h->old_table[h->migrate_pos++];
+        if (slot >= 0){
+            history_table_put(h, slot);
+        }
+    }
+    if (h->migrate_pos > h->old_mask){
+        free(h->old_table);
+        h->old_table = NULL;
+    }
+}
+
+
+/* Find the bucket holding the command in the given table, -1 if absent */
+int64_t history_table_find(HistoryIndex *h, int *table, uint64_t mask, const char *command, uint64_t hash){
+    uint64_t i = hash & mask;
+    while (table[i] != HISTORY_EMPTY){
+        int slot = table[i];
+        if (slot >= 0 && h->entries[slot].hash == hash && strcmp(h->entries[slot].command, command) == 0){
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+
+void lru_unlink(HistoryIndex *h, int slot){
+    ProcessHistory *e = &h->entries[slot];
+    if (e->lru_prev == -1){
+        h->lru_head = e->lru_next;
+    } else {
+        h->entries[e->lru_prev].lru_next = e->lru_next;
+    }
+    if (e->lru_next == -1){
+        h->lru_tail = e->lru_prev;
+    } else {
+        h->entries[e->lru_next].lru_prev = e->lru_prev;
+    }
+}
+
+
+void lru_push_front(HistoryIndex *h, int slot){
+    ProcessHistory *e = &h->entries[slot];
+    e->lru_prev = -1;
+    e->lru_next = h->lru_head;
+    if (h->lru_head == -1){
+        h->lru_tail = slot;
+    } else {
+        h->entries[h->lru_head].lru_prev = slot;
+    }
+    h->lru_head = slot;
+}
+
+
+/* Evict the least recently used history that no pending process refers to, false if all are pinned */
+bool history_evict_one(HistoryIndex *h){
+    int slot = h->lru_tail;
+    while (slot != -1 && h->entries[slot].refs > 0){
+        slot = h->entries[slot].lru_prev;
+    }
+    if (slot == -1){
+        return false;
+    }
+
+    ProcessHistory *e = &h->entries[slot];
+    int64_t bucket = history_table_find(h, h->table, h->table_mask, e->command, e->hash);
+    if (bucket >= 0){
+        h->table[bucket] = HISTORY_TOMBSTONE;
+    } else if (h->old_table != NULL){
+        bucket = history_table_find(h, h->old_table, h->old_mask, e->command, e->hash);
+        h->old_table[bucket] = HISTORY_TOMBSTONE;
+    }
+    lru_unlink(h, slot);
+    if (h->store != NULL){
+        history_store_erase(h->store, slot);
+    }
+    burst_model_free(&e->model);
+    slab_free(e->command);
+    e->command = NULL;
+    h->free_slots[h->num_free++] = slot;
+    h->size--;
+    return true;
+}
+
+
+/* Start moving to a larger table when the current one gets too full of entries and tombstones */
+void history_maybe_grow(HistoryIndex *h){
+    if ((uint64_t)(h->table_used + 1) * 10 < (h->table_mask + 1) * 7){
+        return;
+    }
+    // a resize still in progress is finished first so that at most two tables exist
+    history_migrate(h, h->old_mask + 1);
+
+    uint64_t buckets = h->table_mask + 1;
+    if ((uint64_t)h->size * 2 >= buckets){
+        buckets *= 2;
+    }
+    h->old_table = h->table;
+    h->old_mask = h->table_mask;
+    h->migrate_pos = 0;
+    h->table = new_history_table(buckets);
+    h->table_mask = buckets - 1;
+    h->table_used = 0;
+}
+
+
+/*
+Find the history slot of the given command
+Input:
+    HistoryIndex *h: the index
+    const char *command: command string
+Output:
+    slot index, -1 if the command has no history
+*/
+int history_index_lookup(HistoryIndex *h, const char *command){
+    history_migrate(h, HISTORY_MIGRATE_STEP);
+    uint64_t hash = hash_command(command);
+    int64_t bucket = history_table_find(h, h->table, h->table_mask, command, hash);
+    int slot = -1;
+    if (bucket >= 0){
+        slot = h->table[bucket];
+    } else if (h->old_table != NULL){
+        bucket = history_table_find(h, h->old_table, h->old_mask, command, hash);
+        if (bucket >= 0){
+            slot = h->old_table[bucket];
+        }
+    }
+    if (slot >= 0){
+        lru_unlink(h, slot);
+        lru_push_front(h, slot);
+    }
+    return slot;
+}
+
+
+/* Copy the program name of the command, the part before the first space */
+void command_prefix(const char *command, char prefix[HISTORY_MAX_PREFIX]){
+    size_t len = strcspn(command, " ");
+    if (len >= HISTORY_MAX_PREFIX){
+        len = HISTORY_MAX_PREFIX - 1;
+    }
+    memcpy(prefix, command, len);
+    prefix[len] = '\0';
+}
+
+
+/*
+Find the history slot of the given command, creating one if absent. A new history predicts the
+burst time of its program with prefix cold start, the default burst time otherwise
+Input:
+    HistoryIndex *h: the index
+    const char *command: command string, copied when a new entry is created
+    bool *created: set to whether a new entry was created, may be NULL
+Output:
+    slot index
+*/
+int history_index_intern(HistoryIndex *h, const char *command, bool *created){
+    int slot = history_index_lookup(h, command);
+    if (created != NULL){
+        *created = slot < 0;
+    }
+    if (slot >= 0){
+        return slot;
+    }
+
+    if (h->max_entries > 0 && h->size >= h->max_entries){
+        history_evict_one(h);
+    }
+    history_maybe_grow(h);
+
+    if (h->num_free > 0){
+        slot = h->free_slots[--h->num_free];
+    } else {
+        if (h->num_entries >= h->capacity){
+            h->capacity *= 2;
+            h->entries = realloc(h->entries, sizeof(ProcessHistory) * h->capacity);
+            h->free_slots = realloc(h->free_slots, sizeof(int) * h->capacity);
+        }
+        slot = h->num_entries++;
+    }
+
+    ProcessHistory *e = &h->entries[slot];
+    e->command = slab_strdup(command);
+    e->predicted_burst_time = h->predictor.default_burst_time;
+    if (h->prefixes != NULL){
+        char prefix[HISTORY_MAX_PREFIX];
+        command_prefix(command, prefix);
+        int prefix_slot = history_index_lookup(h->prefixes, prefix);
+        if (prefix_slot >= 0){
+            e->predicted_burst_time = history_at(h->prefixes, prefix_slot)->predicted_burst_time;
+        }
+    }
+    burst_model_init(&e->model);
+    e->hash = hash_command(command);
+    e->refs = 0;
+    history_table_put(h, slot);
+    lru_push_front(h, slot);
+    h->size++;
+    if (h->store != NULL){
+        history_store_put(h->store, slot, e->command, e->predicted_burst_time, &e->model);
+    }
+    return slot;
+}
+
+
+/*
+Record the burst time of a completed process and update the prediction of its command
+Input:
+    HistoryIndex *h: the index
+    int slot: history slot of the command
+    uint64_t burst_time: burst time of the process
+*/
+void history_record_burst(HistoryIndex *h, int slot, uint64_t burst_time){
+    ProcessHistory *e = &h->entries[slot];
+    prediction_stats_add(&h->stats, e->predicted_burst_time, burst_time);
+    burst_model_record(&e->model, &h->predictor, burst_time);
+    e->predicted_burst_time = burst_model_predict(&e->model, &h->predictor, e->predicted_burst_time);
+    if (h->store != NULL){
+        history_store_put(h->store, slot, e->command, e->predicted_burst_time, &e->model);
+    }
+    if (h->prefixes != NULL){
+        char prefix[HISTORY_MAX_PREFIX];
+        command_prefix(e->command, prefix);
+        history_record_burst(h->prefixes, history_index_intern(h->prefixes, prefix, NULL), burst_time);
+    }
+}
+
+
+/*
+Load the histories saved in the store and keep it up to date from now on.
+Histories that get a different slot than the record they were loaded from are moved in the store,
+records that are already in place are only read.
+Input:
+    HistoryIndex *h: an empty index
+    HistoryStore *s: an open store
+*/
+void history_index_attach_store(HistoryIndex *h, HistoryStore *s){
+    // models of another predictor are not reused, only their last prediction
+    bool same_predictor = s->header->predictor_kind == h->predictor.kind && h->predictor.kind != PREDICT_PERCENTILE;
+    s->header->predictor_kind = h->predictor.kind;
+    uint64_t reserve = s->header->num_records;
+    if (h->max_entries > 0 && reserve > (uint64_t)h->max_entries){
+        reserve = h->max_entries;
+    }
+    history_index_reserve(h, reserve);
+    char command[HISTORY_STORE_MAX_COMMAND];
+    for (uint64_t i=0; i<s->header->num_records; i++){
+        HistoryRecord *r = history_store_record(s, i);
+        if (!history_record_valid(r)){
+            history_store_erase(s, i);
+            continue;
+        }
+        memcpy(command, r->command, r->command_len);
+        command[r->command_len] = '\0';
+        int slot = history_index_intern(h, command, NULL);
+        ProcessHistory *e = history_at(h, slot);
+        e->predicted_burst_time = r->predicted_burst_time;
+        if (same_predictor){
+            e->model.estimate = r->estimate;
+            e->model.count = r->count;
+        }
+        // slots are handed out in order, a new slot never holds a record that is still to be read
+        if ((uint64_t)slot != i || !same_predictor){
+            history_store_put(s, slot, e->command, e->predicted_burst_time, &e->model);
+            if ((uint64_t)slot != i){
+                history_store_erase(s, i);
+            }
+        }
+    }
+    // slots freed by evictions while loading
+    for (int k=0; k<h->num_free; k++){
+        history_store_erase(s, h->free_slots[k]);
+    }
+    h->store = s;
+}
+
+
+/* Pin the history of a pending process so it is not evicted */
+void history_index_pin(HistoryIndex *h, int slot){
+    h->entries[slot].refs++;
+}
+
+
+/* Release the pin taken for a process that is no longer pending */
+void history_index_unpin(HistoryIndex *h, int slot){
+    h->entries[slot].refs--;
+}
+
+
+void history_index_free(HistoryIndex *h){
+    for (int i=h->lru_head; i!=-1; i=h->entries[i].lru_next){
+        burst_model_free(&h->entries[i].model);
+        slab_free(h->entries[i].command);
+    }
+    if (h->prefixes != NULL){
+        history_index_free(h->prefixes);
+        free(h->prefixes);
+    }
+    free(h->entries);
+    free(h->free_slots);
+    free(h->table);
+    free(h->old_table);
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "burst_predictor.h"
+
+#define HISTORY_STORE_MAGIC "PSHIST1"
+#define HISTORY_STORE_VERSION 1
+#define HISTORY_STORE_MAX_COMMAND 212
+#define HISTORY_STORE_MIN_RECORDS 1024
+
+
+/*
+Memory-mapped file holding the learned burst time of every command, so that a restarted online
+scheduler starts from its previous predictions.
+Record i mirrors history slot i. Updates are plain stores into the shared mapping, the kernel writes
+them back, so a job completion costs no syscall and the data survives a crash of the scheduler.
+Every record carries a sequence number, odd while it is being written, and a checksum of its
+contents: records torn by a crash of the machine are detected and skipped when loading.
+*/
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t predictor_kind;    // PredictorKind that produced the models
+    uint32_t reserved;
+    uint64_t num_records;
+} HistoryStoreHeader;
+
+
+typedef struct {
+    uint64_t seq;
+    uint64_t checksum;
+    uint64_t predicted_burst_time;
+    uint64_t count;
+    double estimate;
+    uint32_t command_len;    // 0 for an empty record
+    char command[HISTORY_STORE_MAX_COMMAND];
+} HistoryRecord;
+
+
+typedef struct {
+    int fd;
+    HistoryStoreHeader *header;
+    size_t map_size;
+} HistoryStore;
+
+
+/* Record i of the store */
+HistoryRecord *history_store_record(HistoryStore *s, uint64_t i){
+    return (HistoryRecord *)(s->header + 1) + i;
+}
+
+
+/* FNV-1a over the contents of the record, from predicted_burst_time to the end of the command */
+uint64_t history_record_checksum(HistoryRecord *r){
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *c = (const unsigned char *)&r->predicted_burst_time;
+    const unsigned char *end = (const unsigned char *)r->command + (r->command_len < HISTORY_STORE_MAX_COMMAND ? r->command_len : 0);
+    for (; c < end; c++){
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+/* true if the record holds a command and was completely written */
+bool history_record_valid(HistoryRecord *r){
+    return r->command_len > 0 && r->command_len < HISTORY_STORE_MAX_COMMAND && r->seq % 2 == 0
+        && r->checksum == history_record_checksum(r);
+}
+
+
+/* Map the file with room for the given number of records */
+bool history_store_map(HistoryStore *s, uint64_t num_records){
+    size_t map_size = sizeof(HistoryStoreHeader) + num_records * sizeof(HistoryRecord);
+    if (ftruncate(s->fd, map_size) < 0){
+        return false;
+    }
+    void *map;
+    if (s->header == NULL){
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    } else {
+        map = mremap(s->header, s->map_size, map_size, MREMAP_MAYMOVE);
+    }
+    if (map == MAP_FAILED){
+        return false;
+    }
+    s->header = map;
+    s->map_size = map_size;
+    s->header->num_records = num_records;
+    return true;
+}
+
+
+/*
+Open the store, creating it if the file is missing and starting over if it is of another version
+or incomplete. The file is locked while the store is open, a scheduler that finds it locked by
+another one does not touch it and runs without a store.
+Input:
+    HistoryStore *s: the store
+    const char *path: file of the store
+    PredictorKind kind: predictor of the scheduler, models of another predictor are not reused
+Output:
+    false if the store cannot be used or is in use by another scheduler, the scheduler then runs without it
+*/
+bool history_store_open(HistoryStore *s, const char *path, PredictorKind kind){
+    s->header = NULL;
+    s->map_size = 0;
+    s->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (s->fd < 0){
+        return false;
+    }
+    struct stat st;
+    if (flock(s->fd, LOCK_EX | LOCK_NB) < 0 || fstat(s->fd, &st) < 0){
+        close(s->fd);
+        return false;
+    }
+
+    bool valid = false;
+    if ((size_t)st.st_size >= sizeof(HistoryStoreHeader)){
+        HistoryStoreHeader header;
+        valid = pread(s->fd, &header, sizeof(header), 0) == sizeof(header)
+            && memcmp(header.magic, HISTORY_STORE_MAGIC, sizeof(header.magic)) == 0
+            && header.version == HISTORY_STORE_VERSION
+            && header.record_size == sizeof(HistoryRecord)
+            && (uint64_t)st.st_size >= sizeof(HistoryStoreHeader) + header.num_records * sizeof(HistoryRecord);
+        if (valid && !history_store_map(s, header.num_records)){
+            close(s->fd);
+            return false;
+        }
+    }
+    if (!valid){
+        if (ftruncate(s->fd, 0) < 0 || !history_store_map(s, HISTORY_STORE_MIN_RECORDS)){
+            close(s->fd);
+            return false;
+        }
+        memcpy(s->header->magic, HISTORY_STORE_MAGIC, sizeof(s->header->magic));
+        s->header->version = HISTORY_STORE_VERSION;
+        s->header->record_size = sizeof(HistoryRecord);
+        s->header->predictor_kind = kind;
+    }
+    return true;
+}
+
+
+/* Make room for record i, growing the file geometrically */
+bool history_store_reserve(HistoryStore *s, uint64_t i){
+    uint64_t num_records = s->header->num_records;
+    if (i < num_records){
+        return true;
+    }
+    while (num_records <= i){
+        num_records *= 2;
+    }
+    return history_store_map(s, num_records);
+}
+
+
+/*
+Write the state of a history into record i
+Input:
+    HistoryStore *s: the store
+    uint64_t i: record index, the history slot
+    const char *command: command of the history, not stored if longer than the record allows
+    uint64_t predicted_burst_time: current prediction
+    BurstModel *model: model of the command
+*/
+void history_store_put(HistoryStore *s, uint64_t i, const char *command, uint64_t predicted_burst_time, BurstModel *model){
+    if (!history_store_reserve(s, i)){
+        return;
+    }
+    HistoryRecord *r = history_store_record(s, i);
+    size_t len = strlen(command);
+    __atomic_store_n(&r->seq, r->seq | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->predicted_burst_time = predicted_burst_time;
+    r->count = model->count;
+    r->estimate = model->estimate;
+    if (len < HISTORY_STORE_MAX_COMMAND){
+        if (r->command_len != len || memcmp(r->command, command, len) != 0){
+            memcpy(r->command, command, len);
+            r->command_len = len;
+        }
+    } else {
+        r->command_len = 0;
+    }
+    r->checksum = history_record_checksum(r);
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+}
+
+
+/* Mark record i empty, records that are already empty are not written to */
+void history_store_erase(HistoryStore *s, uint64_t i){
+    if (i < s->header->num_records && history_store_record(s, i)->command_len != 0){
+        history_store_record(s, i)->command_len = 0;
+    }
+}
+
+
+/* Unmap the store and flush it to disk */
+void history_store_close(HistoryStore *s){
+    msync(s->header, s->map_size, MS_SYNC);
+    munmap(s->header, s->map_size);
+    close(s->fd);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "utils.h"
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#define INTAKE_BUFFER_SIZE 65536
+
+
+/* A command read from the input, the command string lives inline after the header, allocated from the slab */
+typedef struct Arrival {
+    struct Arrival *next;
+    uint64_t arrival_time;
+    uint32_t job_id;    // position of the command in the input
+    char **args;    // argv of the command, tokenized on the intake thread
+    char command[];
+} Arrival;
+
+
+/*
+Reads commands on a dedicated thread and hands them to the scheduler loop.
+Arrivals go through a lock-free multi-producer single-consumer queue (Vyukov's intrusive
+design): producers only exchange the head pointer, the scheduler owns the tail.
+The eventfd is signalled after every batch so an idle scheduler can block on it.
+*/
+typedef struct {
+    Arrival *head;
+    Arrival *tail;
+    Arrival *stub;
+    int event_fd;
+    int input_fd;
+    bool eof;
+    uint32_t num_lines;    // commands read so far
+    uint64_t scheduler_start_time;
+    pthread_t thread;
+} ArrivalQueue;
+
+
+/* Publish an arrival, safe to call from any number of threads */
+void intake_push(ArrivalQueue *q, Arrival *a){
+    __atomic_store_n(&a->next, NULL, __ATOMIC_RELAXED);
+    Arrival *prev = __atomic_exchange_n(&q->head, a, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, a, __ATOMIC_RELEASE);
+}
+
+
+/* Take the oldest arrival, NULL if there is none. Only the scheduler thread may call this */
+Arrival *intake_pop(ArrivalQueue *q){
+    Arrival *tail = q->tail;
+    Arrival *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == q->stub){
+        if (next == NULL){
+            return NULL;
+        }
+        q->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL){
+        q->tail = next;
+        return tail;
+    }
+    // tail is the last published node, or a producer is between its exchange and its link
+    if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    intake_push(q, q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL){
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+
+/* Release an arrival once its command is interned, its args are handed over to the process */
+void arrival_free(Arrival *a){
+    slab_free(a);
+}
+
+
+/* Wake the scheduler loop */
+void intake_notify(ArrivalQueue *q){
+    uint64_t one = 1;
+    write(q->event_fd, &one, sizeof(one));
+}
+
+
+/* Stamp and publish one line of input, blank lines are skipped */
+void intake_line(ArrivalQueue *q, const char *line, size_t len, uint64_t arrival_time){
+    if (len > 0 && line[len-1] == '\r'){
+        len--;
+    }
+    if (len == 0){
+        return;
+    }
+    Arrival *a = slab_alloc(sizeof(Arrival) + len + 1);
+    a->arrival_time = arrival_time;
+    a->job_id = q->num_lines++;
+    memcpy(a->command, line, len);
+    a->command[len] = '\0';
+    a->args = tokenize_command(a->command);
+    intake_push(q, a);
+}
+
+
+/* Intake thread: read the input in large blocks and publish every complete line */
+void *intake_loop(void *arg){
+    ArrivalQueue *q = arg;
+    size_t capacity = INTAKE_BUFFER_SIZE;
+    char *buffer = malloc(capacity);
+    size_t len = 0;
+
+    while (1){
+        if (len == capacity){
+            // a single line longer than the buffer
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+        }
+        ssize_t res = read(q->input_fd, buffer + len, capacity - len);
+        if (res < 0 && errno == EINTR){
+            continue;
+        }
+        if (res <= 0){
+            break;
+        }
+
+        // every line of one read arrived at the same time
+        uint64_t arrival_time = ms_time(q->scheduler_start_time);
+        size_t scanned = len;
+        size_t line_start = 0;
+        len += res;
+        char *newline;
+        while ((newline = memchr(buffer + scanned, '\n', len - scanned)) != NULL){
+            size_t line_end = newline - buffer;
+            intake_line(q, buffer + line_start, line_end - line_start, arrival_time);
+            line_start = line_end + 1;
+            scanned = line_start;
+        }
+        memmove(buffer, buffer + line_start, len - line_start);
+        len -= line_start;
+        intake_notify(q);
+    }
+
+    // the last line may not end with a newline
+    intake_line(q, buffer, len, ms_time(q->scheduler_start_time));
+    __atomic_store_n(&q->eof, true, __ATOMIC_RELEASE);
+    intake_notify(q);
+    free(buffer);
+    return NULL;
+}
+
+
+/*
+Start reading commands from the given file descriptor on a new thread
+Input:
+    ArrivalQueue *q: queue to initialise
+    int input_fd: file descriptor to read commands from
+    uint64_t scheduler_start_time: start time of the scheduler, arrivals are relative to it
+*/
+void intake_start(ArrivalQueue *q, int input_fd, uint64_t scheduler_start_time){
+    q->stub = malloc(sizeof(Arrival));
+    q->stub->next = NULL;
+    q->head = q->stub;
+    q->tail = q->stub;
+    q->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    q->input_fd = input_fd;
+    q->eof = false;
+    q->num_lines = 0;
+    q->scheduler_start_time = scheduler_start_time;
+    pthread_create(&q->thread, NULL, intake_loop, q);
+}
+
+
+/* true once the input is closed, every arrival was published before this turns true */
+bool intake_closed(ArrivalQueue *q){
+    return __atomic_load_n(&q->eof, __ATOMIC_ACQUIRE);
+}
+
+
+/* Reset the eventfd after a wake up, does not block */
+void intake_clear(ArrivalQueue *q){
+    uint64_t count;
+    read(q->event_fd, &count, sizeof(count));
+}
+
+
+/* Block until the intake thread signals new arrivals or the end of the input */
+void intake_wait(ArrivalQueue *q){
+    struct pollfd pfd = {.fd = q->event_fd, .events = POLLIN};
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR){
+    }
+    intake_clear(q);
+}
+
+
+/* Wait for the intake thread to finish and release the queue */
+void intake_stop(ArrivalQueue *q){
+    pthread_join(q->thread, NULL);
+    Arrival *a;
+    while ((a = intake_pop(q)) != NULL){
+        slab_free(a->args);
+        arrival_free(a);
+    }
+    free(q->stub);
+    close(q->event_fd);
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+
+#define CGROUP_PATH_MAX 4096
+#define CGROUP_FREEZE_MS 100    // longest wait for a job to be frozen
+#define CGROUP_DRAIN_MS 100    // wait at exit for the processes of killed jobs
+
+
+/*
+cgroup v2 backend of the schedulers: every job runs in its own cgroup under cgroup_parent.
+A slice is paused and resumed by writing cgroup.freeze, which stops the command together with
+every process it forked, where SIGSTOP only stops the process that was started; a pause returns once
+cgroup.events reports the job frozen. cpu.stat gives the cpu time of the whole job. The cgroup files
+are kept open, so a resume or a cpu time read is a single pwrite or pread.
+Without cgroup_parent, or if it cannot be used, jobs are sliced with SIGSTOP and SIGCONT as before.
+*/
+typedef struct JobCgroup {
+    char name[64];    // directory of the cgroup under cgroup_parent
+    int dir_fd;
+    int freeze_fd;
+    int stat_fd;
+    int procs_fd;    // cgroup.procs, the child of cgroup_spawn moves itself in through it
+    int events_fd;    // cgroup.events, kept open while the cgroup waits to be removed
+    struct JobCgroup *next;    // next cgroup waiting to be removed
+} JobCgroup;
+
+
+// delegated cgroup v2 directory the job cgroups are created in, "auto" for the cgroup of the
+// scheduler, NULL to slice jobs with signals. Set it before starting a scheduler
+static const char *cgroup_parent = NULL;
+
+static pthread_once_t cgroup_once = PTHREAD_ONCE_INIT;
+static int cgroup_parent_fd = -1;
+static bool cgroup_spawn_failed = false;    // set once jobs cannot be spawned into their cgroups
+static uint64_t cgroup_next_id = 0;
+
+// killed cgroups whose processes have not all exited yet, removed by later passes
+static pthread_mutex_t cgroup_busy_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t cgroup_busy_once = PTHREAD_ONCE_INIT;
+static JobCgroup *cgroup_busy = NULL;
+
+
+/* Directory of the cgroup v2 cgroup of the calling process, false if there is no cgroup v2 hierarchy */
+bool cgroup_own_path(char *path, size_t size){
+    char line[CGROUP_PATH_MAX];
+    char mount[CGROUP_PATH_MAX] = "";
+    char own[CGROUP_PATH_MAX] = "";
+
+    FILE *mounts = fopen("/proc/self/mounts", "r");
+    if (mounts == NULL){
+        return false;
+    }
+    while (fgets(line, sizeof(line), mounts) != NULL){
+        char dir[CGROUP_PATH_MAX], type[64];
+        if (sscanf(line, "%*s %4095s %63s", dir, type) == 2 && strcmp(type, "cgroup2") == 0){
+            strcpy(mount, dir);
+            break;
+        }
+    }
+    fclose(mounts);
+
+    // the cgroup v2 entry is the one of hierarchy 0 without controllers: 0::/path
+    FILE *cgroup = fopen("/proc/self/cgroup", "r");
+    if (cgroup == NULL){
+        return false;
+    }
+    while (fgets(line, sizeof(line), cgroup) != NULL){
+        if (strncmp(line, "0::", 3) == 0){
+            line[strcspn(line, "\n")] = '\0';
+            strcpy(own, line + 3);
+            break;
+        }
+    }
+    fclose(cgroup);
+
+    if (mount[0] == '\0' || own[0] == '\0'){
+        return false;
+    }
+    return snprintf(path, size, "%s%s", mount, strcmp(own, "/") == 0 ? "" : own) < (int)size;
+}
+
+
+/* Open cgroup_parent once, cgroup_parent_fd stays -1 if the backend cannot be used */
+void cgroup_backend_init(){
+    const char *parent = cgroup_parent;
+    char own[CGROUP_PATH_MAX];
+    if (parent == NULL){
+        return;
+    }
+    if (!cgroup_own_path(own, sizeof(own))){
+        fprintf(stderr, "cgroup v2 is not available, slicing jobs with signals\n");
+        return;
+    }
+    if (strcmp(parent, "auto") == 0){
+        parent = own;
+    }
+    cgroup_parent_fd = open(parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroup_parent_fd < 0 || faccessat(cgroup_parent_fd, ".", W_OK, 0) < 0){
+        fprintf(stderr, "cannot create cgroups in %s (%s), slicing jobs with signals\n", parent, strerror(errno));
+        if (cgroup_parent_fd >= 0) close(cgroup_parent_fd);
+        cgroup_parent_fd = -1;
+    }
+}
+
+
+/* Remove the waiting cgroups that are empty by now, the caller holds cgroup_busy_lock */
+void cgroup_remove_busy(){
+    JobCgroup **link = &cgroup_busy;
+    while (*link != NULL){
+        JobCgroup *cg = *link;
+        if (unlinkat(cgroup_parent_fd, cg->name, AT_REMOVEDIR) < 0 && errno == EBUSY){
+            link = &cg->next;
+            continue;
+        }
+        *link = cg->next;
+        close(cg->events_fd);
+        free(cg);
+    }
+}
+
+
+/* Monotonic time in milliseconds */
+uint64_t cgroup_clock_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/* At exit, wait a bounded time for the waiting cgroups to empty and remove them */
+void cgroup_drain_busy(){
+    pthread_mutex_lock(&cgroup_busy_lock);
+    uint64_t deadline = cgroup_clock_ms() + CGROUP_DRAIN_MS;
+    while (cgroup_busy != NULL){
+        uint64_t now = cgroup_clock_ms();
+        if (now >= deadline){
+            break;
+        }
+        // cgroup.events signals POLLPRI when its populated field changes
+        struct pollfd fds[64];
+        int n = 0;
+        for (JobCgroup *cg=cgroup_busy; cg!=NULL && n<64; cg=cg->next){
+            fds[n++] = (struct pollfd){.fd = cg->events_fd, .events = POLLPRI};
+        }
+        poll(fds, n, deadline - now);
+        cgroup_remove_busy();
+    }
+    pthread_mutex_unlock(&cgroup_busy_lock);
+}
+
+
+void cgroup_register_drain(){
+    atexit(cgroup_drain_busy);
+}
+
+
+/* Create the cgroup of a new job, NULL if the backend is disabled or the cgroup cannot be created */
+JobCgroup *cgroup_create(){
+    if (cgroup_parent == NULL || __atomic_load_n(&cgroup_spawn_failed, __ATOMIC_RELAXED)){
+        return NULL;
+    }
+    pthread_once(&cgroup_once, cgroup_backend_init);
+    if (cgroup_parent_fd < 0){
+        return NULL;
+    }
+    // cgroups left busy by earlier jobs are removed here, unless another thread is already at it
+    if (__atomic_load_n(&cgroup_busy, __ATOMIC_RELAXED) != NULL && pthread_mutex_trylock(&cgroup_busy_lock) == 0){
+        cgroup_remove_busy();
+        pthread_mutex_unlock(&cgroup_busy_lock);
+    }
+
+    JobCgroup *cg = malloc(sizeof(JobCgroup));
+    snprintf(cg->name, sizeof(cg->name), "job-%d-%lu", getpid(), __atomic_fetch_add(&cgroup_next_id, 1, __ATOMIC_RELAXED));
+    cg->next = NULL;
+    if (mkdirat(cgroup_parent_fd, cg->name, 0755) < 0){
+        free(cg);
+        return NULL;
+    }
+    cg->dir_fd = openat(cgroup_parent_fd, cg->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    cg->freeze_fd = cg->dir_fd >= 0 ? openat(cg->dir_fd, "cgroup.freeze", O_WRONLY | O_CLOEXEC) : -1;
+    cg->stat_fd = cg->dir_fd >= 0 ? openat(cg->dir_fd, "cpu.stat", O_RDONLY | O_CLOEXEC) : -1;
+    cg->procs_fd = cg->dir_fd >= 0 ? openat(cg->dir_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC) : -1;
+    cg->events_fd = cg->dir_fd >= 0 ? openat(cg->dir_fd, "cgroup.events", O_RDONLY | O_CLOEXEC) : -1;
+    if (cg->freeze_fd < 0 || cg->stat_fd < 0 || cg->procs_fd < 0 || cg->events_fd < 0){
+        if (cg->dir_fd >= 0) close(cg->dir_fd);
+        if (cg->freeze_fd >= 0) close(cg->freeze_fd);
+        if (cg->stat_fd >= 0) close(cg->stat_fd);
+        if (cg->procs_fd >= 0) close(cg->procs_fd);
+        if (cg->events_fd >= 0) close(cg->events_fd);
+        unlinkat(cgroup_parent_fd, cg->name, AT_REMOVEDIR);
+        free(cg);
+        return NULL;
+    }
+    return cg;
+}
+
+
+/*
+Start a command inside the cgroup of its job.
+The child moves itself into the cgroup through cgroup.procs before it execs, so nothing the command
+forks can be left outside and the scheduler never changes cgroup. Signals stay blocked in the child
+until the exec, and an error before or at the exec comes back through a close-on-exec pipe.
+Input:
+    JobCgroup *cg: cgroup of the job
+    pid_t *pid: set to the pid of the command
+    char **args: argv of the command
+    const int output_fds[2]: stdout and stderr of the command, NULL to keep the scheduler's
+Output:
+    0, the error of the exec, or -1 if the job cannot be started in its cgroup
+*/
+int cgroup_spawn(JobCgroup *cg, pid_t *pid, char **args, const int output_fds[2]){
+    int status_fds[2];
+    if (pipe2(status_fds, O_CLOEXEC) < 0){
+        return -1;
+    }
+    sigset_t all, mask;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &mask);
+    pid_t child = fork();
+    if (child == 0){
+        // negative if the child cannot enter the cgroup, positive if the command cannot be executed
+        int error;
+        if (write(cg->procs_fd, "0", 1) < 0){
+            error = -errno;
+        } else if (output_fds != NULL && (dup2(output_fds[0], STDOUT_FILENO) < 0 || dup2(output_fds[1], STDERR_FILENO) < 0)){
+            error = errno;
+        } else {
+            sigprocmask(SIG_SETMASK, &mask, NULL);
+            execvp(args[0], args);
+            error = errno;
+        }
+        write(status_fds[1], &error, sizeof(error));
+        _exit(127);
+    }
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    close(status_fds[1]);
+    if (child < 0){
+        close(status_fds[0]);
+        return -1;
+    }
+
+    // end of file once the exec succeeded
+    int error = 0;
+    ssize_t len;
+    while ((len = read(status_fds[0], &error, sizeof(error))) < 0 && errno == EINTR);
+    close(status_fds[0]);
+    if (len <= 0){
+        *pid = child;
+        return 0;
+    }
+    waitpid(child, NULL, 0);
+    if (error < 0){
+        if (error != -EAGAIN && error != -ENOMEM && !__atomic_exchange_n(&cgroup_spawn_failed, true, __ATOMIC_RELAXED)){
+            fprintf(stderr, "cannot start jobs in cgroups (%s), slicing jobs with signals\n", strerror(-error));
+        }
+        return -1;
+    }
+    return error;
+}
+
+
+/* Whether cgroup.events reports every process of the job frozen */
+bool cgroup_frozen(JobCgroup *cg){
+    char buf[256];
+    ssize_t len = pread(cg->events_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0){
+        return true;
+    }
+    buf[len] = '\0';
+    return strstr(buf, "frozen 1") != NULL;
+}
+
+
+/* Stop or restart every process of the job, a stop returns once the job is frozen or after CGROUP_FREEZE_MS */
+void cgroup_freeze(JobCgroup *cg, bool frozen){
+    pwrite(cg->freeze_fd, frozen ? "1" : "0", 1, 0);
+    if (!frozen){
+        return;
+    }
+    uint64_t deadline = cgroup_clock_ms() + CGROUP_FREEZE_MS;
+    while (!cgroup_frozen(cg)){
+        uint64_t now = cgroup_clock_ms();
+        if (now >= deadline){
+            break;
+        }
+        // cgroup.events signals POLLPRI when its frozen field changes
+        struct pollfd pfd = {.fd = cg->events_fd, .events = POLLPRI};
+        poll(&pfd, 1, deadline - now);
+    }
+}
+
+
+/* Cpu time in milliseconds used by every process of the job so far */
+uint64_t cgroup_cpu_time(JobCgroup *cg){
+    char buf[256];
+    ssize_t len = pread(cg->stat_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0){
+        return 0;
+    }
+    buf[len] = '\0';
+    unsigned long usage_usec;
+    if (sscanf(buf, "usage_usec %lu", &usage_usec) != 1){
+        return 0;
+    }
+    return usage_usec / 1000;
+}
+
+
+/*
+Kill whatever the job left running and remove its cgroup.
+Processes the command forked and did not wait for keep the cgroup busy until they are gone: they are
+killed and the cgroup is left to a later cgroup_create, so the scheduler never waits for them.
+*/
+void cgroup_destroy(JobCgroup *cg){
+    bool busy = unlinkat(cgroup_parent_fd, cg->name, AT_REMOVEDIR) < 0 && errno == EBUSY;
+    if (busy){
+        int kill_fd = openat(cg->dir_fd, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+        if (kill_fd >= 0){
+            write(kill_fd, "1", 1);
+            close(kill_fd);
+        }
+        cgroup_freeze(cg, false);
+    }
+    close(cg->dir_fd);
+    close(cg->freeze_fd);
+    close(cg->stat_fd);
+    close(cg->procs_fd);
+    if (busy){
+        pthread_once(&cgroup_busy_once, cgroup_register_drain);
+        pthread_mutex_lock(&cgroup_busy_lock);
+        cg->next = cgroup_busy;
+        __atomic_store_n(&cgroup_busy, cg, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&cgroup_busy_lock);
+        return;
+    }
+    close(cg->events_fd);
+    free(cg);
+}
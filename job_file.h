@@ -0,0 +1,401 @@
+#pragma once
+
+#include "offline_schedulers.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define JOB_FILE_CHUNK_BITS 16
+#define JOB_FILE_CHUNK (1 << JOB_FILE_CHUNK_BITS)    // process records allocated at once
+#define JOB_FILE_MAX_CHUNKS 32767    // job ids stay below INT_MAX
+#define JOB_FILE_SIGNAL_EVERY 1024    // jobs indexed between two wake-ups of the scheduler
+
+
+/*
+Streaming loader of offline batches: a job file holds one command per line, blank lines are skipped.
+The file is mapped privately and an indexer thread walks it, ending every line in place and filling
+process records whose command points into the mapping, so loading allocates nothing per job: the
+records come in chunks of JOB_FILE_CHUNK and the commands are never copied. The scheduler starts on
+the first job while the indexer is still working through the rest of the file.
+The offline policies queue every job at time 0 in file order, ahead of any job that used up a slice,
+so the jobs the indexer has not reached yet are the front of that queue: the policies below run them
+first, waiting for the indexer when it is behind, and schedule exactly as the array-based
+FCFS, RoundRobin and MultiLevelFeedbackQueue do on the same commands.
+*/
+typedef struct {
+    char *map;
+    size_t size;
+    Process **chunks;
+    char *last_line;    // copy of a last line without a newline, which cannot be ended in place
+    int indexed;    // jobs whose records are ready, published with release ordering
+    bool done;    // set once the whole file is indexed
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t indexer;
+} JobFile;
+
+
+Process *job_file_process(JobFile *f, int job){
+    return &f->chunks[job >> JOB_FILE_CHUNK_BITS][job & (JOB_FILE_CHUNK - 1)];
+}
+
+
+/* Append the record of a job, the command must stay valid while the file is open */
+void job_file_append(JobFile *f, char *command){
+    int job = f->indexed;
+    if ((job & (JOB_FILE_CHUNK - 1)) == 0){
+        f->chunks[job >> JOB_FILE_CHUNK_BITS] = malloc(sizeof(Process) * JOB_FILE_CHUNK);
+    }
+    Process *p = job_file_process(f, job);
+    memset(p, 0, sizeof(Process));
+    p->command = command;
+    p->job_id = job;
+    __atomic_store_n(&f->indexed, job + 1, __ATOMIC_RELEASE);
+    if ((job + 1) % JOB_FILE_SIGNAL_EVERY == 0 || job == 0){
+        pthread_mutex_lock(&f->lock);
+        pthread_cond_broadcast(&f->cond);
+        pthread_mutex_unlock(&f->lock);
+    }
+}
+
+
+/* Indexer thread: end every line in place and publish its record */
+void *job_file_indexer(void *arg){
+    JobFile *f = arg;
+    char *end = f->map + f->size;
+    char *line = f->map;
+    while (line < end && f->indexed < JOB_FILE_MAX_CHUNKS * JOB_FILE_CHUNK){
+        char *newline = memchr(line, '\n', end - line);
+        char *line_end = newline != NULL ? newline : end;
+        char *next = newline != NULL ? newline + 1 : end;
+        if (line_end > line && line_end[-1] == '\r'){
+            line_end--;
+        }
+        if (line_end > line){
+            if (newline != NULL){
+                *line_end = '\0';
+                job_file_append(f, line);
+            } else {
+                f->last_line = strndup(line, line_end - line);
+                job_file_append(f, f->last_line);
+            }
+        }
+        line = next;
+    }
+    pthread_mutex_lock(&f->lock);
+    __atomic_store_n(&f->done, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&f->cond);
+    pthread_mutex_unlock(&f->lock);
+    return NULL;
+}
+
+
+/* Map a job file and start indexing it, false if it cannot be read */
+bool job_file_open(JobFile *f, const char *path){
+    memset(f, 0, sizeof(JobFile));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0){
+        perror(path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    f->size = st.st_size;
+    if (f->size > 0){
+        // private and writable, so lines are ended in place without touching the file
+        f->map = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (f->map == MAP_FAILED){
+            perror(path);
+            close(fd);
+            return false;
+        }
+        madvise(f->map, f->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    f->chunks = calloc(JOB_FILE_MAX_CHUNKS, sizeof(Process *));
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->cond, NULL);
+    pthread_create(&f->indexer, NULL, job_file_indexer, f);
+    return true;
+}
+
+
+/*
+Number of jobs the scheduler can take, and whether the file is fully indexed
+Input:
+    JobFile *f: the job file
+    bool *done: set to true if no more jobs will be indexed
+Output: number of indexed jobs
+*/
+int job_file_indexed(JobFile *f, bool *done){
+    // done first: once it is set, indexed is final
+    *done = __atomic_load_n(&f->done, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&f->indexed, __ATOMIC_ACQUIRE);
+}
+
+
+/* Block until job next is indexed or the file is done */
+void job_file_wait(JobFile *f, int next){
+    bool done;
+    pthread_mutex_lock(&f->lock);
+    while (job_file_indexed(f, &done) <= next && !done){
+        pthread_cond_wait(&f->cond, &f->lock);
+    }
+    pthread_mutex_unlock(&f->lock);
+}
+
+
+void job_file_close(JobFile *f){
+    pthread_join(f->indexer, NULL);
+    for (int c=0; c<JOB_FILE_MAX_CHUNKS && f->chunks[c] != NULL; c++){
+        free(f->chunks[c]);
+    }
+    free(f->chunks);
+    free(f->last_line);
+    if (f->map != NULL){
+        munmap(f->map, f->size);
+    }
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->cond);
+}
+
+
+/* Jobs of a job file being scheduled, every file policy state starts with it */
+typedef struct {
+    JobFile *f;
+    int next;    // first job not started yet
+    bool done;    // the file was fully indexed when the last pick looked
+} FileJobs;
+
+
+/* Jobs indexed so far, the pick remembers whether the file was done */
+int file_jobs_indexed(FileJobs *jobs, bool *done){
+    int indexed = job_file_indexed(jobs->f, done);
+    jobs->done = *done;
+    return indexed;
+}
+
+
+Process *file_process(void *state, int job){
+    return job_file_process(((FileJobs *)state)->f, job);
+}
+
+
+/*
+Called when the pick found no job: it had seen the file done with nothing left to run, or it may
+have looked before the indexer finished, so it picks again once the next job is indexed or the file
+is done, which then lets it run the jobs still queued
+*/
+bool file_wait(void *state){
+    FileJobs *jobs = state;
+    if (jobs->done){
+        return false;
+    }
+    job_file_wait(jobs->f, jobs->next);
+    return true;
+}
+
+
+int file_fcfs_pick(void *state, uint64_t now, int *quantum){
+    FileJobs *s = state;
+    bool done;
+    *quantum = -1;
+    return s->next < file_jobs_indexed(s, &done) ? s->next++ : -1;
+}
+
+
+/* Jobs indexed so far count as arrived, those not started yet as pending */
+void file_jobs_metrics(FileJobs *jobs, LiveSnapshot *snapshot){
+    bool done;
+    int indexed = job_file_indexed(jobs->f, &done);
+    snapshot->arrivals = indexed;
+    snapshot->pending = indexed - jobs->next;
+}
+
+
+void file_fcfs_metrics(void *state, LiveSnapshot *snapshot){
+    file_jobs_metrics(state, snapshot);
+}
+
+
+static const SchedulerPolicy file_fcfs_policy = {
+    .pick = file_fcfs_pick,
+    .wait = file_wait,
+    .process = file_process,
+    .metrics = file_fcfs_metrics
+};
+
+
+/*
+First Come First Serve Scheduling of the jobs of a job file
+Input:
+    const char *path: job file, one command per line
+Output: None
+*/
+void FCFSFile(const char *path){
+    uint64_t scheduler_start_time = ms_time(0);
+    JobFile f;
+    if (!job_file_open(&f, path)){
+        return;
+    }
+    FileJobs s = {.f = &f, .next = 0, .done = false};
+    run_scheduler(file_fcfs_policy, &s, "result_offline_FCFS.csv", scheduler_start_time);
+    job_file_close(&f);
+}
+
+
+typedef struct {
+    FileJobs jobs;
+    JobLinks links;
+    JobList queue;    // jobs that used up a slice, behind the jobs not started yet
+    int quantum;
+} FileRoundRobinState;
+
+
+int file_round_robin_pick(void *state, uint64_t now, int *quantum){
+    FileRoundRobinState *s = state;
+    bool done;
+    int indexed = file_jobs_indexed(&s->jobs, &done);
+    *quantum = s->quantum;
+    if (s->jobs.next < indexed){
+        job_links_reserve(&s->links, s->jobs.next + 1);
+        return s->jobs.next++;
+    }
+    return done ? job_list_pop_front(&s->links, &s->queue) : -1;
+}
+
+
+void file_round_robin_requeue(void *state, int job){
+    FileRoundRobinState *s = state;
+    job_list_push_back(&s->links, &s->queue, job);
+}
+
+
+void file_round_robin_metrics(void *state, LiveSnapshot *snapshot){
+    FileRoundRobinState *s = state;
+    file_jobs_metrics(&s->jobs, snapshot);
+    snapshot->pending += s->queue.size;
+}
+
+
+static const SchedulerPolicy file_round_robin_policy = {
+    .pick = file_round_robin_pick,
+    .requeue = file_round_robin_requeue,
+    .wait = file_wait,
+    .process = file_process,
+    .metrics = file_round_robin_metrics
+};
+
+
+/*
+Round Robin Scheduling of the jobs of a job file
+Input:
+    const char *path: job file, one command per line
+    int quantum: time slice in milliseconds
+Output: None
+*/
+void RoundRobinFile(const char *path, int quantum){
+    uint64_t scheduler_start_time = ms_time(0);
+    JobFile f;
+    if (!job_file_open(&f, path)){
+        return;
+    }
+    FileRoundRobinState s = {.jobs = {.f = &f}, .quantum = quantum};
+    job_links_init(&s.links, JOB_FILE_CHUNK);
+    job_list_init(&s.queue);
+    run_scheduler(file_round_robin_policy, &s, "result_offline_RR.csv", scheduler_start_time);
+    job_links_free(&s.links);
+    job_file_close(&f);
+}
+
+
+typedef struct {
+    FileJobs jobs;
+    MlfqState mlfq;
+} FileMlfqState;
+
+
+int file_mlfq_pick(void *state, uint64_t now, int *quantum){
+    FileMlfqState *s = state;
+    bool done;
+    int indexed = file_jobs_indexed(&s->jobs, &done);
+    if (s->jobs.next < indexed){
+        // the jobs not started yet are the front of level 0, a due boost goes behind them
+        job_links_reserve(&s->mlfq.links, s->jobs.next + 1);
+        job_list_push_front(&s->mlfq.links, &s->mlfq.queue.level[0], s->jobs.next++);
+    } else if (!done){
+        return -1;
+    }
+    return mlfq_pick(&s->mlfq, now, quantum);
+}
+
+
+void file_mlfq_requeue(void *state, int job){
+    mlfq_requeue(&((FileMlfqState *)state)->mlfq, job);
+}
+
+
+void file_mlfq_complete(void *state, int job){
+    FileMlfqState *s = state;
+    mlfq_complete(&s->mlfq, job_file_process(s->jobs.f, job));
+}
+
+
+/* The jobs not started yet are counted at level 0, which they are the front of */
+void file_mlfq_metrics(void *state, LiveSnapshot *snapshot){
+    FileMlfqState *s = state;
+    mlfq_metrics(&s->mlfq, snapshot);
+    uint32_t queued = snapshot->pending;
+    file_jobs_metrics(&s->jobs, snapshot);
+    snapshot->level_depth[0] += snapshot->pending;
+    snapshot->pending += queued;
+}
+
+
+static const SchedulerPolicy file_mlfq_policy = {
+    .pick = file_mlfq_pick,
+    .requeue = file_mlfq_requeue,
+    .complete = file_mlfq_complete,
+    .wait = file_wait,
+    .process = file_process,
+    .metrics = file_mlfq_metrics
+};
+
+
+/*
+Multi-Level Feedback Queue Scheduling of the jobs of a job file with any number of queues
+Input:
+    const char *path: job file, one command per line
+    int num_levels: number of queues, from 1 to MAX_QUEUE_LEVELS
+    int quantum[]: time slice of each queue, queue 0 having the highest priority
+    int boostTime: time after which all processes are boosted to the highest priority queue
+Output: None
+*/
+void MultiLevelFeedbackQueueLevelsFile(const char *path, int num_levels, int quantum[], int boostTime){
+    if (!mlfq_levels_valid(num_levels)){
+        return;
+    }
+    uint64_t scheduler_start_time = ms_time(0);
+    JobFile f;
+    if (!job_file_open(&f, path)){
+        return;
+    }
+    FileMlfqState s = {.jobs = {.f = &f}};
+    mlfq_init(&s.mlfq, JOB_FILE_CHUNK, num_levels, quantum, boostTime);
+    run_scheduler(file_mlfq_policy, &s, "result_offline_MLFQ.csv", scheduler_start_time);
+    mlfq_free(&s.mlfq);
+    job_file_close(&f);
+}
+
+
+/*
+Multi-Level Feedback Queue Scheduling of the jobs of a job file with 3 queues
+Input:
+    const char *path: job file, one command per line
+    int quantum0, quantum1, quantum2: time slices of the queues
+    int boostTime: time after which all processes are boosted to the highest priority queue
+Output: None
+*/
+void MultiLevelFeedbackQueueFile(const char *path, int quantum0, int quantum1, int quantum2, int boostTime){
+    int quantum[3] = {quantum0, quantum1, quantum2};
+    MultiLevelFeedbackQueueLevelsFile(path, 3, quantum, boostTime);
+}
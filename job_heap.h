@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+Indexed binary min-heap of process indices ordered by (key, seq).
+pos[] remembers where every process sits in the heap, so the key of a queued process can be
+raised or lowered in O(log n). seq breaks ties so equal keys come out in insertion order.
+*/
+typedef struct {
+    int *heap;
+    int size;
+    int *pos;    // position of each process in heap, -1 when not queued
+    uint64_t *key;
+    uint64_t *seq;
+    int capacity;    // number of process indices the per-process arrays can hold
+} JobHeap;
+
+
+void job_heap_init(JobHeap *h, int capacity){
+    h->capacity = capacity > 0 ? capacity : 1;
+    h->heap = malloc(sizeof(int) * h->capacity);
+    h->pos = malloc(sizeof(int) * h->capacity);
+    h->key = malloc(sizeof(uint64_t) * h->capacity);
+    h->seq = malloc(sizeof(uint64_t) * h->capacity);
+    h->size = 0;
+}
+
+
+/* Grow the heap so that process indices below capacity can be queued */
+void job_heap_reserve(JobHeap *h, int capacity){
+    if (capacity <= h->capacity){
+        return;
+    }
+    int new_capacity = h->capacity;
+    while (new_capacity < capacity){
+        new_capacity *= 2;
+    }
+    h->heap = realloc(h->heap, sizeof(int) * new_capacity);
+    h->pos = realloc(h->pos, sizeof(int) * new_capacity);
+    h->key = realloc(h->key, sizeof(uint64_t) * new_capacity);
+    h->seq = realloc(h->seq, sizeof(uint64_t) * new_capacity);
+    h->capacity = new_capacity;
+}
+
+
+void job_heap_free(JobHeap *h){
+    free(h->heap);
+    free(h->pos);
+    free(h->key);
+    free(h->seq);
+}
+
+
+/* true if process a has to come out of the heap before process b */
+static inline int job_heap_before(JobHeap *h, int a, int b){
+    return h->key[a] < h->key[b] || (h->key[a] == h->key[b] && h->seq[a] < h->seq[b]);
+}
+
+
+static inline void job_heap_place(JobHeap *h, int i, int job){
+    h->heap[i] = job;
+    h->pos[job] = i;
+}
+
+
+void job_heap_sift_up(JobHeap *h, int i){
+    int job = h->heap[i];
+    while (i > 0){
+        int parent = (i - 1) / 2;
+        if (!job_heap_before(h, job, h->heap[parent])){
+            break;
+        }
+        job_heap_place(h, i, h->heap[parent]);
+        i = parent;
+    }
+    job_heap_place(h, i, job);
+}
+
+
+void job_heap_sift_down(JobHeap *h, int i){
+    int job = h->heap[i];
+    while (1){
+        int child = 2 * i + 1;
+        if (child >= h->size){
+            break;
+        }
+        if (child + 1 < h->size && job_heap_before(h, h->heap[child+1], h->heap[child])){
+            child++;
+        }
+        if (!job_heap_before(h, h->heap[child], job)){
+            break;
+        }
+        job_heap_place(h, i, h->heap[child]);
+        i = child;
+    }
+    job_heap_place(h, i, job);
+}
+
+
+/* Queue a process with the given key, seq orders processes with equal keys */
+void job_heap_push(JobHeap *h, int job, uint64_t key, uint64_t seq){
+    h->key[job] = key;
+    h->seq[job] = seq;
+    job_heap_place(h, h->size++, job);
+    job_heap_sift_up(h, h->size - 1);
+}
+
+
+/* Remove and return the process with the smallest key, -1 if empty */
+int job_heap_pop(JobHeap *h){
+    if (h->size == 0){
+        return -1;
+    }
+    int job = h->heap[0];
+    h->pos[job] = -1;
+    h->size--;
+    if (h->size > 0){
+        job_heap_place(h, 0, h->heap[h->size]);
+        job_heap_sift_down(h, 0);
+    }
+    return job;
+}
+
+
+/* Change the key of a queued process and restore the heap order */
+void job_heap_update(JobHeap *h, int job, uint64_t key){
+    uint64_t old_key = h->key[job];
+    h->key[job] = key;
+    if (key < old_key){
+        job_heap_sift_up(h, h->pos[job]);
+    } else if (key > old_key){
+        job_heap_sift_down(h, h->pos[job]);
+    }
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+#define JOB_OUTPUT_PIPE_SIZE (256 * 1024)
+#define JOB_OUTPUT_SPLICE_MAX (64 * 1024)
+#define JOB_OUTPUT_DRAIN_MS 1000
+
+
+/*
+Capture of the stdout and stderr of the jobs into per-job log files.
+Every job gets a pipe for each stream, and a collector thread moves what arrives in them into
+<job_output_dir>/job-<job_id>.stdout and .stderr with splice, so the data goes from the pipe to the
+page cache of the log without a copy through user space, and the scheduling loop never reads job
+output. Once a stream reached job_output_cap bytes the rest is spliced into /dev/null and the log
+ends with a truncation note; a job is never blocked on a full log.
+A stream is closed when every process holding its pipe exited. The collector starts with the first
+captured job, and job_output_stop, called when a scheduler is done, waits up to JOB_OUTPUT_DRAIN_MS
+for the streams still open, so the logs of the last jobs are complete, then stops the collector.
+*/
+typedef struct JobOutputStream {
+    int pipe_fd;    // read end of the pipe
+    int log_fd;
+    uint64_t written;    // bytes in the log
+    uint64_t dropped;    // bytes past job_output_cap
+    struct JobOutputStream *prev, *next;    // open streams
+} JobOutputStream;
+
+
+// directory of the job logs, NULL to let the jobs write to the stdout and stderr of the scheduler.
+// Set it before starting a scheduler
+static const char *job_output_dir = NULL;
+// bytes kept of each stream of a job
+static uint64_t job_output_cap = 1 << 20;
+
+// the collector and the list of open streams, under job_output_lock
+static pthread_mutex_t job_output_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_output_all_closed = PTHREAD_COND_INITIALIZER;
+static bool job_output_running = false;
+static bool job_output_failed = false;    // the collector cannot be started, jobs are not captured
+static pthread_t job_output_thread;
+static int job_output_epoll_fd = -1;
+static int job_output_null_fd = -1;
+static int job_output_stop_fd = -1;    // eventfd that stops the collector
+static JobOutputStream *job_output_streams = NULL;
+static int job_output_open_streams = 0;
+
+
+/* Splice what is in the pipe into the log, false once every writer closed the pipe */
+bool job_output_drain(JobOutputStream *s){
+    while (1){
+        bool capped = s->written >= job_output_cap;
+        size_t len = capped ? JOB_OUTPUT_SPLICE_MAX : job_output_cap - s->written;
+        if (len > JOB_OUTPUT_SPLICE_MAX){
+            len = JOB_OUTPUT_SPLICE_MAX;
+        }
+        ssize_t res = splice(s->pipe_fd, NULL, capped ? job_output_null_fd : s->log_fd, NULL, len,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (res > 0){
+            *(capped ? &s->dropped : &s->written) += res;
+        } else if (res == 0){
+            return false;
+        } else {
+            return errno == EAGAIN || errno == EINTR;
+        }
+    }
+}
+
+
+void job_output_close(JobOutputStream *s){
+    if (s->dropped > 0){
+        dprintf(s->log_fd, "\n[output truncated at %lu bytes, %lu bytes dropped]\n", s->written, s->dropped);
+    }
+    epoll_ctl(job_output_epoll_fd, EPOLL_CTL_DEL, s->pipe_fd, NULL);
+    close(s->pipe_fd);
+    close(s->log_fd);
+
+    pthread_mutex_lock(&job_output_lock);
+    if (s->prev != NULL){
+        s->prev->next = s->next;
+    } else {
+        job_output_streams = s->next;
+    }
+    if (s->next != NULL){
+        s->next->prev = s->prev;
+    }
+    if (--job_output_open_streams == 0){
+        pthread_cond_broadcast(&job_output_all_closed);
+    }
+    pthread_mutex_unlock(&job_output_lock);
+    free(s);
+}
+
+
+/* Collector thread on the given epoll fd: drain the pipes as they become readable and close them at end of file, until stopped */
+void *job_output_collector(void *arg){
+    int epoll_fd = *(int *)arg;
+    struct epoll_event events[64];
+    bool stopped = false;
+    while (!stopped){
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        for (int i=0; i<n; i++){
+            JobOutputStream *s = events[i].data.ptr;
+            if (s == NULL){
+                stopped = true;
+            } else if (!job_output_drain(s)){
+                job_output_close(s);
+            }
+        }
+    }
+    // streams still held open by processes the jobs left behind keep what reached them so far
+    while (1){
+        pthread_mutex_lock(&job_output_lock);
+        JobOutputStream *s = job_output_streams;
+        pthread_mutex_unlock(&job_output_lock);
+        if (s == NULL){
+            break;
+        }
+        job_output_drain(s);
+        job_output_close(s);
+    }
+    return NULL;
+}
+
+
+/* Start the collector, the caller holds job_output_lock. Returns false if output cannot be captured */
+bool job_output_start_collector(){
+    job_output_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    job_output_null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    job_output_stop_fd = eventfd(0, EFD_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (job_output_epoll_fd < 0 || job_output_null_fd < 0 || job_output_stop_fd < 0
+            || epoll_ctl(job_output_epoll_fd, EPOLL_CTL_ADD, job_output_stop_fd, &event) < 0
+            || pthread_create(&job_output_thread, NULL, job_output_collector, &job_output_epoll_fd) != 0){
+        fprintf(stderr, "cannot capture job output (%s), jobs write to the scheduler's stdout\n", strerror(errno));
+        if (job_output_epoll_fd >= 0) close(job_output_epoll_fd);
+        if (job_output_null_fd >= 0) close(job_output_null_fd);
+        if (job_output_stop_fd >= 0) close(job_output_stop_fd);
+        job_output_epoll_fd = job_output_null_fd = job_output_stop_fd = -1;
+        job_output_failed = true;
+        return false;
+    }
+    job_output_running = true;
+    return true;
+}
+
+
+/*
+Stop the collector once a scheduler is done: wait up to JOB_OUTPUT_DRAIN_MS for the streams of the
+jobs to be closed, then the collector saves what is left in the other pipes, closes them and exits.
+A later scheduler starts a new collector. Does nothing if no output was captured
+*/
+void job_output_stop(){
+    pthread_mutex_lock(&job_output_lock);
+    if (!job_output_running){
+        pthread_mutex_unlock(&job_output_lock);
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += JOB_OUTPUT_DRAIN_MS / 1000;
+    deadline.tv_nsec += (JOB_OUTPUT_DRAIN_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L){
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (job_output_open_streams > 0 && pthread_cond_timedwait(&job_output_all_closed, &job_output_lock, &deadline) == 0);
+    job_output_running = false;
+    pthread_mutex_unlock(&job_output_lock);
+
+    uint64_t stop = 1;
+    write(job_output_stop_fd, &stop, sizeof(stop));
+    pthread_join(job_output_thread, NULL);
+    close(job_output_epoll_fd);
+    close(job_output_null_fd);
+    close(job_output_stop_fd);
+    job_output_epoll_fd = job_output_null_fd = job_output_stop_fd = -1;
+}
+
+
+/* Create the log of one stream and hand its pipe to the collector, returns the write end or -1 */
+int job_output_stream(const char *dir, uint32_t job_id, const char *suffix){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/job-%u.%s", dir, job_id, suffix);
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0){
+        return -1;
+    }
+    int log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (log_fd < 0){
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    // room for bursts of output while the collector is behind, the job blocks once it is full
+    fcntl(fds[0], F_SETPIPE_SZ, JOB_OUTPUT_PIPE_SIZE);
+
+    JobOutputStream *s = malloc(sizeof(JobOutputStream));
+    s->pipe_fd = fds[0];
+    s->log_fd = log_fd;
+    s->written = 0;
+    s->dropped = 0;
+    pthread_mutex_lock(&job_output_lock);
+    s->prev = NULL;
+    s->next = job_output_streams;
+    if (s->next != NULL){
+        s->next->prev = s;
+    }
+    job_output_streams = s;
+    job_output_open_streams++;
+    pthread_mutex_unlock(&job_output_lock);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = s};
+    epoll_ctl(job_output_epoll_fd, EPOLL_CTL_ADD, s->pipe_fd, &event);
+    return fds[1];
+}
+
+
+/*
+Redirect the stdout and stderr of a job to its logs
+Input:
+    uint32_t job_id: names the logs
+    posix_spawn_file_actions_t *actions: initialized here, pass it to posix_spawnp
+    int write_fds[2]: write ends of the pipes, close them once the job is spawned
+Output:
+    false if capture is disabled or the logs cannot be created, actions is then not initialized
+*/
+bool job_output_open(uint32_t job_id, posix_spawn_file_actions_t *actions, int write_fds[2]){
+    const char *dir = job_output_dir;
+    if (dir == NULL){
+        return false;
+    }
+    pthread_mutex_lock(&job_output_lock);
+    bool running = job_output_running || (!job_output_failed && job_output_start_collector());
+    pthread_mutex_unlock(&job_output_lock);
+    if (!running){
+        return false;
+    }
+    write_fds[0] = job_output_stream(dir, job_id, "stdout");
+    write_fds[1] = write_fds[0] >= 0 ? job_output_stream(dir, job_id, "stderr") : -1;
+    if (write_fds[1] < 0){
+        // the collector closes a stream whose write end is gone
+        if (write_fds[0] >= 0) close(write_fds[0]);
+        return false;
+    }
+    posix_spawn_file_actions_init(actions);
+    posix_spawn_file_actions_adddup2(actions, write_fds[0], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(actions, write_fds[1], STDERR_FILENO);
+    return true;
+}
+
+
+/* Release what job_output_open set up once the job is spawned, or failed to */
+void job_output_spawned(posix_spawn_file_actions_t *actions, int write_fds[2]){
+    posix_spawn_file_actions_destroy(actions);
+    close(write_fds[0]);
+    close(write_fds[1]);
+}
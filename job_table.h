@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/*
+Job table for large offline batches, split between hot and cold state.
+The state a scheduling decision reads and writes, the service time left and whether the job started,
+is a 16-byte entry of the active array, apart from the commands and result records, which are only
+touched when a job starts and completes. Schedulers that run the jobs in passes (Round Robin)
+compact the active array in place as jobs complete, keeping the order of the others, so the hot
+state of the jobs left stays contiguous and a pass streams through it without skipping over finished
+jobs. Schedulers that keep their own run order (MLFQ) do not compact and find job i at active[i].
+*/
+typedef struct {
+    uint64_t remaining;    // service time left
+    uint32_t job;
+    uint32_t started;
+} ActiveJob;
+
+
+typedef struct {
+    ActiveJob *active;    // jobs not yet completed, in run order
+    int num_active;
+    int n;
+} JobTable;
+
+
+/* Table of n jobs, all active in index order, the caller sets their remaining service times */
+void job_table_init(JobTable *t, int n){
+    t->active = malloc(sizeof(ActiveJob) * (n > 0 ? n : 1));
+    for (int i=0; i<n; i++){
+        t->active[i].job = i;
+        t->active[i].started = 0;
+    }
+    t->num_active = n;
+    t->n = n;
+}
+
+
+void job_table_free(JobTable *t){
+    free(t->active);
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define JOB_TREE_NIL 0
+
+
+/*
+Intrusive red-black tree of process indices ordered by (key, seq), used where a scheduler needs the
+smallest key of a changing set together with ordered removal of any process.
+Insertion and removal are O(log n) and the leftmost process is cached, so reading the minimum is O(1).
+Process i is node i+1 of the per-node arrays, node 0 is the black sentinel leaf.
+*/
+typedef struct {
+    int *left;
+    int *right;
+    int *parent;
+    char *red;
+    uint64_t *key;
+    uint64_t *seq;
+    int root;
+    int leftmost;
+    int size;
+    int capacity;    // number of process indices the per-node arrays can hold
+} JobTree;
+
+
+void job_tree_alloc(JobTree *t, int capacity){
+    t->left = realloc(t->left, sizeof(int) * (capacity + 1));
+    t->right = realloc(t->right, sizeof(int) * (capacity + 1));
+    t->parent = realloc(t->parent, sizeof(int) * (capacity + 1));
+    t->red = realloc(t->red, capacity + 1);
+    t->key = realloc(t->key, sizeof(uint64_t) * (capacity + 1));
+    t->seq = realloc(t->seq, sizeof(uint64_t) * (capacity + 1));
+    t->capacity = capacity;
+}
+
+
+void job_tree_init(JobTree *t, int capacity){
+    t->left = t->right = t->parent = NULL;
+    t->red = NULL;
+    t->key = t->seq = NULL;
+    job_tree_alloc(t, capacity > 0 ? capacity : 1);
+    t->red[JOB_TREE_NIL] = 0;
+    t->root = JOB_TREE_NIL;
+    t->leftmost = JOB_TREE_NIL;
+    t->size = 0;
+}
+
+
+/* Grow the tree so that process indices below capacity can be inserted */
+void job_tree_reserve(JobTree *t, int capacity){
+    if (capacity <= t->capacity){
+        return;
+    }
+    int new_capacity = t->capacity;
+    while (new_capacity < capacity){
+        new_capacity *= 2;
+    }
+    job_tree_alloc(t, new_capacity);
+}
+
+
+void job_tree_free(JobTree *t){
+    free(t->left);
+    free(t->right);
+    free(t->parent);
+    free(t->red);
+    free(t->key);
+    free(t->seq);
+}
+
+
+/* true if node a comes before node b */
+static inline int job_tree_before(JobTree *t, int a, int b){
+    return t->key[a] < t->key[b] || (t->key[a] == t->key[b] && t->seq[a] < t->seq[b]);
+}
+
+
+/* Put node v in the place of node u under the parent of u */
+static inline void job_tree_transplant(JobTree *t, int u, int v){
+    int parent = t->parent[u];
+    if (parent == JOB_TREE_NIL){
+        t->root = v;
+    } else if (u == t->left[parent]){
+        t->left[parent] = v;
+    } else {
+        t->right[parent] = v;
+    }
+    t->parent[v] = parent;
+}
+
+
+void job_tree_rotate_left(JobTree *t, int x){
+    int y = t->right[x];
+    t->right[x] = t->left[y];
+    if (t->left[y] != JOB_TREE_NIL){
+        t->parent[t->left[y]] = x;
+    }
+    job_tree_transplant(t, x, y);
+    t->left[y] = x;
+    t->parent[x] = y;
+}
+
+
+void job_tree_rotate_right(JobTree *t, int x){
+    int y = t->left[x];
+    t->left[x] = t->right[y];
+    if (t->right[y] != JOB_TREE_NIL){
+        t->parent[t->right[y]] = x;
+    }
+    job_tree_transplant(t, x, y);
+    t->right[y] = x;
+    t->parent[x] = y;
+}
+
+
+/* Insert a process with the given key, seq orders processes with equal keys */
+void job_tree_insert(JobTree *t, int job, uint64_t key, uint64_t seq){
+    int z = job + 1;
+    t->key[z] = key;
+    t->seq[z] = seq;
+    t->left[z] = t->right[z] = JOB_TREE_NIL;
+    t->red[z] = 1;
+
+    int parent = JOB_TREE_NIL;
+    int x = t->root;
+    bool leftmost = true;
+    while (x != JOB_TREE_NIL){
+        parent = x;
+        if (job_tree_before(t, z, x)){
+            x = t->left[x];
+        } else {
+            x = t->right[x];
+            leftmost = false;
+        }
+    }
+    t->parent[z] = parent;
+    if (parent == JOB_TREE_NIL){
+        t->root = z;
+    } else if (job_tree_before(t, z, parent)){
+        t->left[parent] = z;
+    } else {
+        t->right[parent] = z;
+    }
+    if (leftmost){
+        t->leftmost = z;
+    }
+    t->size++;
+
+    // restore the red-black properties going up from the new red node
+    while (t->red[t->parent[z]]){
+        int p = t->parent[z];
+        int g = t->parent[p];
+        if (p == t->left[g]){
+            int uncle = t->right[g];
+            if (t->red[uncle]){
+                t->red[p] = t->red[uncle] = 0;
+                t->red[g] = 1;
+                z = g;
+                continue;
+            }
+            if (z == t->right[p]){
+                z = p;
+                job_tree_rotate_left(t, z);
+                p = t->parent[z];
+            }
+            t->red[p] = 0;
+            t->red[g] = 1;
+            job_tree_rotate_right(t, g);
+        } else {
+            int uncle = t->left[g];
+            if (t->red[uncle]){
+                t->red[p] = t->red[uncle] = 0;
+                t->red[g] = 1;
+                z = g;
+                continue;
+            }
+            if (z == t->left[p]){
+                z = p;
+                job_tree_rotate_right(t, z);
+                p = t->parent[z];
+            }
+            t->red[p] = 0;
+            t->red[g] = 1;
+            job_tree_rotate_left(t, g);
+        }
+    }
+    t->red[t->root] = 0;
+}
+
+
+static inline int job_tree_minimum(JobTree *t, int x){
+    while (t->left[x] != JOB_TREE_NIL){
+        x = t->left[x];
+    }
+    return x;
+}
+
+
+/* Remove a process that is in the tree */
+void job_tree_remove(JobTree *t, int job){
+    int z = job + 1;
+    if (z == t->leftmost){
+        // the leftmost node has no left child, its successor is in its right subtree or its parent
+        t->leftmost = t->right[z] != JOB_TREE_NIL ? job_tree_minimum(t, t->right[z]) : t->parent[z];
+    }
+
+    int y = z;
+    bool removed_black = !t->red[y];
+    int x;
+    if (t->left[z] == JOB_TREE_NIL){
+        x = t->right[z];
+        job_tree_transplant(t, z, x);
+    } else if (t->right[z] == JOB_TREE_NIL){
+        x = t->left[z];
+        job_tree_transplant(t, z, x);
+    } else {
+        y = job_tree_minimum(t, t->right[z]);
+        removed_black = !t->red[y];
+        x = t->right[y];
+        if (t->parent[y] == z){
+            t->parent[x] = y;
+        } else {
+            job_tree_transplant(t, y, x);
+            t->right[y] = t->right[z];
+            t->parent[t->right[y]] = y;
+        }
+        job_tree_transplant(t, z, y);
+        t->left[y] = t->left[z];
+        t->parent[t->left[y]] = y;
+        t->red[y] = t->red[z];
+    }
+    t->size--;
+
+    // x carries an extra black, push it up until it lands on a red node or the root
+    while (removed_black && x != t->root && !t->red[x]){
+        int p = t->parent[x];
+        if (x == t->left[p]){
+            int w = t->right[p];
+            if (t->red[w]){
+                t->red[w] = 0;
+                t->red[p] = 1;
+                job_tree_rotate_left(t, p);
+                w = t->right[p];
+            }
+            if (!t->red[t->left[w]] && !t->red[t->right[w]]){
+                t->red[w] = 1;
+                x = p;
+                continue;
+            }
+            if (!t->red[t->right[w]]){
+                t->red[t->left[w]] = 0;
+                t->red[w] = 1;
+                job_tree_rotate_right(t, w);
+                w = t->right[p];
+            }
+            t->red[w] = t->red[p];
+            t->red[p] = 0;
+            t->red[t->right[w]] = 0;
+            job_tree_rotate_left(t, p);
+        } else {
+            int w = t->left[p];
+            if (t->red[w]){
+                t->red[w] = 0;
+                t->red[p] = 1;
+                job_tree_rotate_right(t, p);
+                w = t->left[p];
+            }
+            if (!t->red[t->left[w]] && !t->red[t->right[w]]){
+                t->red[w] = 1;
+                x = p;
+                continue;
+            }
+            if (!t->red[t->left[w]]){
+                t->red[t->right[w]] = 0;
+                t->red[w] = 1;
+                job_tree_rotate_left(t, w);
+                w = t->left[p];
+            }
+            t->red[w] = t->red[p];
+            t->red[p] = 0;
+            t->red[t->left[w]] = 0;
+            job_tree_rotate_right(t, p);
+        }
+        x = t->root;
+    }
+    t->red[x] = 0;
+}
+
+
+/* Process with the smallest key, -1 if the tree is empty */
+int job_tree_first(JobTree *t){
+    return t->leftmost - 1;
+}
+
+
+/* Key of a process that is in the tree */
+uint64_t job_tree_key(JobTree *t, int job){
+    return t->key[job + 1];
+}
+
+
+/* Remove and return the process with the smallest key, -1 if empty */
+int job_tree_pop(JobTree *t){
+    int job = job_tree_first(t);
+    if (job != -1){
+        job_tree_remove(t, job);
+    }
+    return job;
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "utils.h"
+#include "run_queue.h"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define LIVE_METRICS_WINDOW 1024    // completions the latency percentiles are computed over
+#define LIVE_METRICS_INTERVAL_MS 100    // shortest time between two snapshots
+#define LIVE_METRICS_TEXT_SIZE 2048
+
+
+/*
+Live metrics of a running scheduler.
+The scheduling loop keeps its counters in private memory and, at most every LIVE_METRICS_INTERVAL_MS
+and whenever it goes idle, publishes a snapshot into a shared memory segment named live_metrics_name
+under a seqlock: the sequence number is odd while the snapshot is being written, and a reader copies
+the snapshot and retries if the sequence changed in the meantime. Readers never block the scheduler.
+Publishing costs a few additions per slice and the sort of the latency window once per interval.
+With live_metrics_socket set, a server thread also answers every connection on that Unix socket
+with the snapshot as text, see tools/sched_stats.c.
+*/
+typedef struct {
+    char scheduler[32];    // result csv of the scheduler
+    int32_t pid;
+    int32_t num_levels;    // MLFQ levels, 0 for policies without levels
+    uint64_t now;    // ms since the scheduler started, at the snapshot
+    uint32_t level_depth[MAX_QUEUE_LEVELS];    // jobs queued at each level
+    uint32_t level_quantum[MAX_QUEUE_LEVELS];
+    uint64_t boost_time;
+    uint32_t pending;    // jobs queued, not counting the running one
+    int32_t history_size;    // commands in the history table, -1 for schedulers without one
+    uint64_t arrivals;
+    uint64_t completions;
+    double arrival_rate;    // jobs per second since the previous snapshot
+    double completion_rate;
+    double quantum_utilization;    // share of the granted slices the jobs ran for, -1 until a job ran for a slice
+    uint64_t response_p50, response_p90, response_p99;    // ms, over the last LIVE_METRICS_WINDOW completions
+    uint64_t turnaround_p50, turnaround_p90, turnaround_p99;
+} LiveSnapshot;
+
+
+/* Layout of the shared memory segment */
+typedef struct {
+    uint64_t seq;    // odd while the snapshot is being written
+    LiveSnapshot snapshot;
+} LiveSegment;
+
+
+// name of the shared memory segment ("/name"), NULL to publish no metrics. Set it before starting a scheduler
+static const char *live_metrics_name = NULL;
+// Unix socket answering with the snapshot as text, NULL for none
+static const char *live_metrics_socket = NULL;
+
+
+/* Private counters of the scheduling loop */
+typedef struct {
+    LiveSegment *segment;    // NULL when disabled
+    LiveSnapshot last;
+    uint64_t last_publish;
+    uint64_t last_arrivals;    // arrivals at the previous snapshot
+    uint64_t completions;
+    uint64_t granted;    // ms of slices granted since the previous snapshot
+    uint64_t used;    // ms of those slices the jobs ran for
+    uint64_t response[LIVE_METRICS_WINDOW];
+    uint64_t turnaround[LIVE_METRICS_WINDOW];
+    bool window_changed;
+    int server_fd;
+    pthread_t server;
+} LiveMetrics;
+
+
+/* Copy a consistent snapshot out of the segment */
+void live_metrics_read(LiveSegment *segment, LiveSnapshot *snapshot){
+    while (1){
+        uint64_t seq = __atomic_load_n(&segment->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1){
+            continue;
+        }
+        memcpy(snapshot, &segment->snapshot, sizeof(LiveSnapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&segment->seq, __ATOMIC_RELAXED) == seq){
+            return;
+        }
+    }
+}
+
+
+/* Write the snapshot as "name value" lines, returns the length of the text */
+int live_metrics_format(LiveSnapshot *s, char *buf, size_t size){
+    int len = snprintf(buf, size,
+        "scheduler %s\npid %d\nuptime_ms %lu\npending %u\n"
+        "arrivals %lu\ncompletions %lu\narrival_rate %.1f\ncompletion_rate %.1f\n"
+        "response_ms p50 %lu p90 %lu p99 %lu\nturnaround_ms p50 %lu p90 %lu p99 %lu\n",
+        s->scheduler, s->pid, s->now, s->pending,
+        s->arrivals, s->completions, s->arrival_rate, s->completion_rate,
+        s->response_p50, s->response_p90, s->response_p99,
+        s->turnaround_p50, s->turnaround_p90, s->turnaround_p99);
+    // fields that do not apply to the scheduler are left out
+    if (s->history_size >= 0 && len < (int)size){
+        len += snprintf(buf + len, size - len, "history_size %d\n", s->history_size);
+    }
+    if (s->quantum_utilization >= 0 && len < (int)size){
+        len += snprintf(buf + len, size - len, "quantum_utilization %.3f\n", s->quantum_utilization);
+    }
+    if (s->num_levels > 0 && len < (int)size){
+        len += snprintf(buf + len, size - len, "boost_ms %lu\nlevel_depth", s->boost_time);
+        for (int l=0; l<s->num_levels && len<(int)size; l++){
+            len += snprintf(buf + len, size - len, " %u", s->level_depth[l]);
+        }
+        if (len < (int)size) len += snprintf(buf + len, size - len, "\nlevel_quantum");
+        for (int l=0; l<s->num_levels && len<(int)size; l++){
+            len += snprintf(buf + len, size - len, " %u", s->level_quantum[l]);
+        }
+        if (len < (int)size) len += snprintf(buf + len, size - len, "\n");
+    }
+    return len < (int)size ? len : (int)size - 1;
+}
+
+
+/* Server thread: answer every connection with the current snapshot */
+void *live_metrics_server(void *arg){
+    LiveMetrics *m = arg;
+    char text[LIVE_METRICS_TEXT_SIZE];
+    int fd;
+    while ((fd = accept4(m->server_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0 || errno == EINTR){
+        if (fd < 0){
+            continue;
+        }
+        LiveSnapshot snapshot;
+        live_metrics_read(m->segment, &snapshot);
+        int len = live_metrics_format(&snapshot, text, sizeof(text));
+        write(fd, text, len);
+        close(fd);
+    }
+    return NULL;
+}
+
+
+void live_metrics_start_server(LiveMetrics *m, const char *path){
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "live metrics socket path too long: %s\n", path);
+        return;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    m->server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m->server_fd < 0 || bind(m->server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(m->server_fd, 16) < 0){
+        fprintf(stderr, "cannot serve live metrics on %s (%s)\n", path, strerror(errno));
+        if (m->server_fd >= 0) close(m->server_fd);
+        m->server_fd = -1;
+        return;
+    }
+    pthread_create(&m->server, NULL, live_metrics_server, m);
+}
+
+
+/* Create the segment and the socket if they are configured */
+void live_metrics_open(LiveMetrics *m, const char *scheduler){
+    memset(m, 0, sizeof(LiveMetrics));
+    m->server_fd = -1;
+    const char *name = live_metrics_name;
+    if (name == NULL){
+        return;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(LiveSegment)) < 0){
+        fprintf(stderr, "cannot publish live metrics in %s (%s)\n", name, strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+    }
+    LiveSegment *segment = mmap(NULL, sizeof(LiveSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED){
+        return;
+    }
+    // a segment left over by an earlier run is reused from scratch
+    memset(segment, 0, sizeof(LiveSegment));
+    m->segment = segment;
+    snprintf(m->last.scheduler, sizeof(m->last.scheduler), "%s", scheduler);
+    m->last.pid = getpid();
+    m->last.history_size = -1;
+    m->last.quantum_utilization = -1;
+
+    const char *socket_path = live_metrics_socket;
+    if (socket_path != NULL){
+        live_metrics_start_server(m, socket_path);
+    }
+}
+
+
+/* A slice of at most quantum ms ran for ran ms */
+static inline void live_metrics_slice(LiveMetrics *m, int quantum, uint64_t ran){
+    m->granted += quantum;
+    m->used += ran < (uint64_t)quantum ? ran : (uint64_t)quantum;
+}
+
+
+/* A job finished or errored */
+static inline void live_metrics_complete(LiveMetrics *m, Process *p){
+    int slot = m->completions++ % LIVE_METRICS_WINDOW;
+    m->response[slot] = p->response_time;
+    m->turnaround[slot] = p->turnaround_time;
+    m->window_changed = true;
+}
+
+
+int live_metrics_compare(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/* 50th, 90th and 99th percentiles of the first n values, sorted in place */
+void live_metrics_percentiles(uint64_t *values, int n, uint64_t *p50, uint64_t *p90, uint64_t *p99){
+    if (n == 0){
+        return;
+    }
+    qsort(values, n, sizeof(uint64_t), live_metrics_compare);
+    *p50 = values[(int)(0.50 * (n - 1))];
+    *p90 = values[(int)(0.90 * (n - 1))];
+    *p99 = values[(int)(0.99 * (n - 1))];
+}
+
+
+/*
+Publish a snapshot, the policy has filled in its own fields of m->last (levels, pending jobs,
+history size and arrivals)
+Input:
+    LiveMetrics *m: the metrics
+    uint64_t now: current time of the scheduler
+*/
+void live_metrics_publish(LiveMetrics *m, uint64_t now){
+    LiveSnapshot *s = &m->last;
+    double elapsed = (now - m->last_publish) / 1000.0;
+    if (elapsed > 0){
+        s->arrival_rate = (s->arrivals - m->last_arrivals) / elapsed;
+        s->completion_rate = (m->completions - s->completions) / elapsed;
+    }
+    if (m->granted > 0){
+        s->quantum_utilization = (double)m->used / m->granted;
+    }
+    m->granted = m->used = 0;
+    m->last_arrivals = s->arrivals;
+    s->now = now;
+    s->completions = m->completions;
+    if (m->window_changed){
+        uint64_t sorted[LIVE_METRICS_WINDOW];
+        int n = m->completions < LIVE_METRICS_WINDOW ? m->completions : LIVE_METRICS_WINDOW;
+        memcpy(sorted, m->response, sizeof(uint64_t) * n);
+        live_metrics_percentiles(sorted, n, &s->response_p50, &s->response_p90, &s->response_p99);
+        memcpy(sorted, m->turnaround, sizeof(uint64_t) * n);
+        live_metrics_percentiles(sorted, n, &s->turnaround_p50, &s->turnaround_p90, &s->turnaround_p99);
+        m->window_changed = false;
+    }
+
+    uint64_t seq = m->segment->seq;
+    __atomic_store_n(&m->segment->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&m->segment->snapshot, s, sizeof(LiveSnapshot));
+    __atomic_store_n(&m->segment->seq, seq + 2, __ATOMIC_RELEASE);
+    m->last_publish = now;
+}
+
+
+/* Stop the server and remove the segment and the socket */
+void live_metrics_close(LiveMetrics *m){
+    if (m->segment == NULL){
+        return;
+    }
+    const char *socket_path = live_metrics_socket;
+    if (m->server_fd >= 0 && socket_path != NULL){
+        // wakes up the accept of the server thread
+        shutdown(m->server_fd, SHUT_RDWR);
+        pthread_join(m->server, NULL);
+        close(m->server_fd);
+        unlink(socket_path);
+    }
+    munmap(m->segment, sizeof(LiveSegment));
+    const char *name = live_metrics_name;
+    if (name != NULL){
+        shm_unlink(name);
+    }
+}
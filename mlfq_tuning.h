@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "run_queue.h"
+
+#define BURST_HISTOGRAM_SUB_BUCKETS 8
+#define BURST_HISTOGRAM_BUCKETS 496    // 8 exact buckets, then 8 sub-buckets for every power of two up to 2^63
+
+
+/*
+Adaptive tuning of the MLFQ time slices and boost period from the burst times the scheduler observes.
+Completed bursts go into a streaming log-linear histogram whose counts are halved every half_life
+bursts, so it follows a distribution that changes over the day. Every interval bursts the slices
+are retuned:
+    - the level 0 slice is the first_percentile of the bursts: that share of the jobs completes in
+      its first slice, without being demoted, and an arrival waits at most one such slice for the cpu,
+      which keeps the mean response time low without slicing the short jobs;
+    - lower levels take percentiles evenly spaced up to last_percentile for the lowest level, so
+      every level lets its share of the remaining jobs complete;
+    - the boost period is boost_factor lowest-level slices, often enough that a demoted job is not
+      starved and not so often that every job is promoted back before it was demoted.
+Every value is clamped to its configured bounds, and only changes of more than 10% are applied and
+logged, so the parameters do not flap between two close values.
+*/
+typedef struct {
+    bool enabled;
+    int min_quantum;
+    int max_quantum;
+    int min_boost;
+    int max_boost;
+    double first_percentile;
+    double last_percentile;
+    double boost_factor;
+    int interval;    // bursts between two retunes
+    int half_life;    // bursts after which a burst counts half
+    FILE *log;    // destination of the parameter changes, NULL for stderr
+} MlfqTuning;
+
+
+// adaptive mode of the offline and online MLFQ schedulers, set it before starting them
+static MlfqTuning mlfq_tuning = {
+    .enabled = false,
+    .min_quantum = 5,
+    .max_quantum = 2000,
+    .min_boost = 100,
+    .max_boost = 60000,
+    .first_percentile = 0.5,
+    .last_percentile = 0.95,
+    .boost_factor = 8,
+    .interval = 100,
+    .half_life = 5000,
+    .log = NULL
+};
+
+
+/* Streaming histogram of burst times with exponentially decaying counts */
+typedef struct {
+    double count[BURST_HISTOGRAM_BUCKETS];
+    double total;
+    uint64_t samples;
+} BurstHistogram;
+
+
+/* Bucket of a burst time: exact below 8, then 8 sub-buckets per power of two */
+int burst_bucket(uint64_t burst){
+    if (burst < BURST_HISTOGRAM_SUB_BUCKETS){
+        return burst;
+    }
+    int msb = 63 - __builtin_clzll(burst);
+    return (msb - 2) * BURST_HISTOGRAM_SUB_BUCKETS + ((burst >> (msb - 3)) & (BURST_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+
+/* Largest burst time that falls into the bucket */
+uint64_t burst_bucket_upper(int bucket){
+    if (bucket < BURST_HISTOGRAM_SUB_BUCKETS){
+        return bucket;
+    }
+    int msb = bucket / BURST_HISTOGRAM_SUB_BUCKETS + 2;
+    uint64_t sub = bucket % BURST_HISTOGRAM_SUB_BUCKETS;
+    return ((BURST_HISTOGRAM_SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+}
+
+
+void burst_histogram_add(BurstHistogram *h, uint64_t burst, int half_life){
+    h->count[burst_bucket(burst)] += 1;
+    h->total += 1;
+    h->samples++;
+    if (half_life > 0 && h->samples % half_life == 0){
+        for (int b=0; b<BURST_HISTOGRAM_BUCKETS; b++){
+            h->count[b] /= 2;
+        }
+        h->total /= 2;
+    }
+}
+
+
+/* Burst time below which the given fraction of the weighted bursts falls */
+uint64_t burst_histogram_quantile(BurstHistogram *h, double q){
+    double target = q * h->total;
+    double seen = 0;
+    for (int b=0; b<BURST_HISTOGRAM_BUCKETS; b++){
+        seen += h->count[b];
+        if (seen >= target && seen > 0){
+            return burst_bucket_upper(b);
+        }
+    }
+    return 0;
+}
+
+
+/* Tuning state of one MLFQ scheduler */
+typedef struct {
+    BurstHistogram histogram;
+    uint64_t retunes;
+} MlfqTuner;
+
+
+int clamp_parameter(double value, int low, int high){
+    return value < low ? low : value > high ? high : (int)(value + 0.5);
+}
+
+
+/* true if the value moved by more than 10% */
+bool parameter_changed(int old_value, int new_value){
+    int diff = old_value > new_value ? old_value - new_value : new_value - old_value;
+    return diff * 10 > old_value;
+}
+
+
+/*
+Record the burst time of a completed job and retune the slices and boost period every interval jobs
+Input:
+    MlfqTuner *t: the tuner
+    int num_levels: number of levels of the scheduler
+    int quantum[]: slices of the levels, updated in place
+    uint64_t *boost_time: boost period, updated in place
+    uint64_t burst_time: burst time of the completed job
+    uint64_t now: current time of the scheduler, for the log
+*/
+void mlfq_tuner_record(MlfqTuner *t, int num_levels, int quantum[], uint64_t *boost_time, uint64_t burst_time, uint64_t now){
+    MlfqTuning *cfg = &mlfq_tuning;
+    burst_histogram_add(&t->histogram, burst_time, cfg->half_life);
+    if (cfg->interval <= 0 || t->histogram.samples % cfg->interval != 0){
+        return;
+    }
+
+    int new_quantum[MAX_QUEUE_LEVELS];
+    for (int l=0; l<num_levels; l++){
+        double percentile = num_levels > 1
+            ? cfg->first_percentile + (cfg->last_percentile - cfg->first_percentile) * l / (num_levels - 1)
+            : cfg->first_percentile;
+        double slice = burst_histogram_quantile(&t->histogram, percentile);
+        new_quantum[l] = clamp_parameter(slice, cfg->min_quantum, cfg->max_quantum);
+        if (l > 0 && new_quantum[l] < new_quantum[l-1]){
+            new_quantum[l] = new_quantum[l-1];
+        }
+    }
+    int new_boost = clamp_parameter(cfg->boost_factor * new_quantum[num_levels-1], cfg->min_boost, cfg->max_boost);
+
+    bool changed = parameter_changed(*boost_time, new_boost);
+    for (int l=0; l<num_levels; l++){
+        changed |= parameter_changed(quantum[l], new_quantum[l]);
+    }
+    if (!changed){
+        return;
+    }
+
+    FILE *log = cfg->log != NULL ? cfg->log : stderr;
+    fprintf(log, "MLFQ tuning at %lu ms after %lu bursts: quantum", now, t->histogram.samples);
+    for (int l=0; l<num_levels; l++){
+        fprintf(log, "%s%d", l == 0 ? " " : ",", quantum[l]);
+    }
+    fprintf(log, " ->");
+    for (int l=0; l<num_levels; l++){
+        fprintf(log, "%s%d", l == 0 ? " " : ",", new_quantum[l]);
+        quantum[l] = new_quantum[l];
+    }
+    fprintf(log, ", boost %lu -> %d\n", *boost_time, new_boost);
+    *boost_time = new_boost;
+    t->retunes++;
+}
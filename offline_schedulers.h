@@ -1,6 +1,62 @@
 #pragma once
 
 #include "utils.h"
+#include "run_queue.h"
+#include "job_heap.h"
+#include "scheduler_engine.h"
+#include <pthread.h>
+#include <sched.h>
+
+// tickets of the stride scheduler are turned into strides of STRIDE_ONE / tickets
+#define STRIDE_ONE (1ULL << 20)
+
+
+/* Processes of an offline run, every offline policy state starts with it */
+typedef struct {
+    Process *p;
+    int n;
+} OfflineJobs;
+
+
+Process *offline_process(void *state, int job){
+    OfflineJobs *jobs = state;
+    return &jobs->p[job];
+}
+
+
+/* Number the processes by their index, the id they are traced under */
+void number_jobs(Process p[], int n){
+    for (int i=0; i<n; i++){
+        p[i].job_id = i;
+    }
+}
+
+
+typedef struct {
+    OfflineJobs jobs;
+    int next;
+} FcfsState;
+
+
+int fcfs_pick(void *state, uint64_t now, int *quantum){
+    FcfsState *s = state;
+    *quantum = -1;
+    return s->next < s->jobs.n ? s->next++ : -1;
+}
+
+
+void fcfs_metrics(void *state, LiveSnapshot *snapshot){
+    FcfsState *s = state;
+    snapshot->pending = s->jobs.n - s->next;
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy fcfs_policy = {
+    .pick = fcfs_pick,
+    .process = offline_process,
+    .metrics = fcfs_metrics
+};
 
 
 /*
@@ -12,13 +68,46 @@ Output: None
 */
 void FCFS(Process p[], int n){
     uint64_t scheduler_start_time = ms_time(0);
-    FILE *file = fopen("result_offline_FCFS.csv", "w");
-    fprintf(file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-    fflush(file);
-    for (int i=0; i<n; i++){
-        run_process_completely(&p[i], scheduler_start_time, file);
-    }
-    fclose(file);
+    number_jobs(p, n);
+    FcfsState s = {.jobs = {p, n}, .next = 0};
+    run_scheduler(fcfs_policy, &s, "result_offline_FCFS.csv", scheduler_start_time);
+};
+
+
+typedef struct {
+    OfflineJobs jobs;
+    JobLinks links;
+    JobList queue;
+    int quantum;
+} RoundRobinState;
+
+
+int round_robin_pick(void *state, uint64_t now, int *quantum){
+    RoundRobinState *s = state;
+    *quantum = s->quantum;
+    return job_list_pop_front(&s->links, &s->queue);
+}
+
+
+/* The process used up its slice, it runs again after every other pending process */
+void round_robin_requeue(void *state, int job){
+    RoundRobinState *s = state;
+    job_list_push_back(&s->links, &s->queue, job);
+}
+
+
+void round_robin_metrics(void *state, LiveSnapshot *snapshot){
+    RoundRobinState *s = state;
+    snapshot->pending = s->queue.size;
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy round_robin_policy = {
+    .pick = round_robin_pick,
+    .requeue = round_robin_requeue,
+    .process = offline_process,
+    .metrics = round_robin_metrics
 };
 
 
@@ -31,28 +120,90 @@ Input:
 Output: None
 */
 void RoundRobin(Process p[], int n, int quantum){
-    int i = -1;
-    int num_finished = 0;
-    int status;
-    int res;
     uint64_t scheduler_start_time = ms_time(0);
+    number_jobs(p, n);
 
-    FILE *file = fopen("result_offline_RR.csv", "w");
-    fprintf(file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-    fflush(file);
-
-    while (num_finished < n){
-        i = (i+1)%n;
-        res = run_process_for_quantum(&p[i], quantum, scheduler_start_time, file);
-        if (res == 0){
-            num_finished++;
-        }
+    // a queue in index order, finished or errored processes leave it, so the cycle skips them
+    RoundRobinState s = {.jobs = {p, n}, .quantum = quantum};
+    job_links_init(&s.links, n);
+    job_list_init(&s.queue);
+    for (int i=0; i<n; i++){
+        job_list_push_back(&s.links, &s.queue, i);
     }
 
-    fclose(file);
+    run_scheduler(round_robin_policy, &s, "result_offline_RR.csv", scheduler_start_time);
+    job_links_free(&s.links);
+};
+
+
+typedef struct {
+    OfflineJobs jobs;
+    MlfqState mlfq;
+} OfflineMlfqState;
+
+
+int offline_mlfq_pick(void *state, uint64_t now, int *quantum){
+    return mlfq_pick(&((OfflineMlfqState *)state)->mlfq, now, quantum);
+}
+
+
+void offline_mlfq_requeue(void *state, int job){
+    mlfq_requeue(&((OfflineMlfqState *)state)->mlfq, job);
+}
+
+
+void offline_mlfq_complete(void *state, int job){
+    OfflineMlfqState *s = state;
+    mlfq_complete(&s->mlfq, &s->jobs.p[job]);
+}
+
+
+void offline_mlfq_metrics(void *state, LiveSnapshot *snapshot){
+    OfflineMlfqState *s = state;
+    mlfq_metrics(&s->mlfq, snapshot);
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy offline_mlfq_policy = {
+    .pick = offline_mlfq_pick,
+    .requeue = offline_mlfq_requeue,
+    .complete = offline_mlfq_complete,
+    .process = offline_process,
+    .metrics = offline_mlfq_metrics
 };
 
 
+/*
+Multi-Level Feedback Queue Scheduling with any number of queues
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int num_levels: number of queues, from 1 to MAX_QUEUE_LEVELS
+    int quantum[]: time slice of each queue, queue 0 having the highest priority
+    int boostTime: time after which all processes are boosted to the highest priority queue
+    the slices and boostTime are the starting point of the adaptive tuning if mlfq_tuning is enabled
+Output: None
+*/
+void MultiLevelFeedbackQueueLevels(Process p[], int n, int num_levels, int quantum[], int boostTime){
+    if (!mlfq_levels_valid(num_levels)){
+        return;
+    }
+    uint64_t scheduler_start_time = ms_time(0);
+    number_jobs(p, n);
+
+    // all processes start in the highest priority queue
+    OfflineMlfqState s = {.jobs = {p, n}};
+    mlfq_init(&s.mlfq, n, num_levels, quantum, boostTime);
+    for (int i=0; i<n; i++){
+        mlfq_add(&s.mlfq, i, 0);
+    }
+
+    run_scheduler(offline_mlfq_policy, &s, "result_offline_MLFQ.csv", scheduler_start_time);
+    mlfq_free(&s.mlfq);
+}
+
+
 /*
 Multi-Level Feedback Queue Scheduling with 3 queues
 Input:
@@ -65,80 +216,549 @@ Input:
 Output: None
 */
 void MultiLevelFeedbackQueue(Process p[], int n, int quantum0, int quantum1, int quantum2, int boostTime){
-
-    // queue[i] has list of indices of processes in queue i
-    int *queue[3] = {malloc(n * sizeof(int)), malloc(n * sizeof(int)), malloc(n * sizeof(int))};
-    int queue_size[3] = {0, 0, 0};
     int quantum[3] = {quantum0, quantum1, quantum2};
+    MultiLevelFeedbackQueueLevels(p, n, 3, quantum, boostTime);
+}
+
+
+/*
+Stride scheduling: every process holds tickets and advances a pass value by STRIDE_ONE / tickets
+for every slice it runs, the process with the smallest pass runs next. Processes receive cpu slices
+in proportion to their tickets, deterministically.
+*/
+typedef struct {
+    OfflineJobs jobs;
+    JobHeap heap;    // keyed by pass
+    uint64_t *stride;
+    uint64_t seq;
+    int quantum;
+} StrideState;
+
+
+int stride_pick(void *state, uint64_t now, int *quantum){
+    StrideState *s = state;
+    *quantum = s->quantum;
+    return job_heap_pop(&s->heap);
+}
+
+
+void stride_requeue(void *state, int job){
+    StrideState *s = state;
+    job_heap_push(&s->heap, job, s->heap.key[job] + s->stride[job], s->seq++);
+}
+
+
+void stride_metrics(void *state, LiveSnapshot *snapshot){
+    StrideState *s = state;
+    snapshot->pending = s->heap.size;
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy stride_policy = {
+    .pick = stride_pick,
+    .requeue = stride_requeue,
+    .process = offline_process,
+    .metrics = stride_metrics
+};
+
+
+/*
+Stride Scheduling
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int tickets[]: share of each process, processes with less than 1 ticket hold 1
+    int quantum: time slice in milliseconds
+Output: None
+*/
+void StrideScheduling(Process p[], int n, int tickets[], int quantum){
+    uint64_t scheduler_start_time = ms_time(0);
+    number_jobs(p, n);
+
+    StrideState s = {.jobs = {p, n}, .seq = n, .quantum = quantum};
+    job_heap_init(&s.heap, n);
+    s.stride = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    for (int i=0; i<n; i++){
+        s.stride[i] = STRIDE_ONE / (tickets[i] > 0 ? tickets[i] : 1);
+        job_heap_push(&s.heap, i, s.stride[i], i);
+    }
+
+    run_scheduler(stride_policy, &s, "result_offline_Stride.csv", scheduler_start_time);
+    job_heap_free(&s.heap);
+    free(s.stride);
+}
+
+
+/*
+Lottery scheduling: every slice goes to a process drawn at random with probability proportional
+to its tickets. The tickets are kept in a Fenwick tree, so a draw and the removal of a completed
+process are O(log n).
+*/
+typedef struct {
+    OfflineJobs jobs;
+    uint64_t *tree;    // Fenwick tree over the tickets of the pending processes, 1-based
+    uint64_t *tickets;
+    uint64_t total;
+    uint64_t rng;
+    int quantum;
+    int num_pending;    // processes in the draw
+} LotteryState;
+
+
+void lottery_add(LotteryState *s, int job, int64_t tickets){
+    for (int i=job+1; i<=s->jobs.n; i += i & -i){
+        s->tree[i] += tickets;
+    }
+    s->total += tickets;
+}
+
+
+int lottery_pick(void *state, uint64_t now, int *quantum){
+    LotteryState *s = state;
+    *quantum = s->quantum;
+    if (s->total == 0){
+        return -1;
+    }
+    // xorshift64*
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    uint64_t winner = (s->rng * 2685821657736338717ULL) % s->total;
+
+    // descend the tree to the process holding the winning ticket
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= s->jobs.n){
+        step *= 2;
+    }
+    for (; step > 0; step /= 2){
+        if (pos + step <= s->jobs.n && s->tree[pos + step] <= winner){
+            pos += step;
+            winner -= s->tree[pos];
+        }
+    }
+    return pos;
+}
+
+
+/* The process used up its slice, it stays in the draw */
+void lottery_requeue(void *state, int job){
+}
+
+
+/* The process finished or errored, its tickets leave the draw */
+void lottery_complete(void *state, int job){
+    LotteryState *s = state;
+    lottery_add(s, job, -(int64_t)s->tickets[job]);
+    s->num_pending--;
+}
+
 
-    // add all processes to the highest priority queue
+void lottery_metrics(void *state, LiveSnapshot *snapshot){
+    LotteryState *s = state;
+    snapshot->pending = s->num_pending;
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy lottery_policy = {
+    .pick = lottery_pick,
+    .requeue = lottery_requeue,
+    .complete = lottery_complete,
+    .process = offline_process,
+    .metrics = lottery_metrics
+};
+
+
+/*
+Lottery Scheduling
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int tickets[]: share of each process, processes with less than 1 ticket hold 1
+    int quantum: time slice in milliseconds
+    uint64_t seed: seed of the draws, the same seed gives the same order of slices
+Output: None
+*/
+void LotteryScheduling(Process p[], int n, int tickets[], int quantum, uint64_t seed){
+    uint64_t scheduler_start_time = ms_time(0);
+    number_jobs(p, n);
+
+    LotteryState s = {.jobs = {p, n}, .total = 0, .rng = seed ? seed : 1, .quantum = quantum, .num_pending = n};
+    s.tree = calloc(n + 1, sizeof(uint64_t));
+    s.tickets = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
     for (int i=0; i<n; i++){
-        queue[0][queue_size[0]++] = i;
+        s.tickets[i] = tickets[i] > 0 ? tickets[i] : 1;
+        lottery_add(&s, i, s.tickets[i]);
     }
 
+    run_scheduler(lottery_policy, &s, "result_offline_Lottery.csv", scheduler_start_time);
+    free(s.tree);
+    free(s.tickets);
+}
+
+typedef struct {
+    OfflineJobs jobs;
+    CfsState cfs;
+} OfflineCfsState;
+
+
+int offline_cfs_pick(void *state, uint64_t now, int *quantum){
+    OfflineCfsState *s = state;
+    return cfs_pick(&s->cfs, s->jobs.p, quantum);
+}
+
+
+void offline_cfs_requeue(void *state, int job){
+    OfflineCfsState *s = state;
+    cfs_requeue(&s->cfs, s->jobs.p, job);
+}
+
+
+void offline_cfs_complete(void *state, int job){
+    cfs_complete(&((OfflineCfsState *)state)->cfs, job);
+}
+
+
+void offline_cfs_metrics(void *state, LiveSnapshot *snapshot){
+    OfflineCfsState *s = state;
+    snapshot->pending = s->cfs.num_runnable;
+    snapshot->arrivals = s->jobs.n;
+}
+
+
+static const SchedulerPolicy offline_cfs_policy = {
+    .pick = offline_cfs_pick,
+    .requeue = offline_cfs_requeue,
+    .complete = offline_cfs_complete,
+    .process = offline_process,
+    .metrics = offline_cfs_metrics
+};
+
+
+/*
+Completely Fair Scheduling: the process with the smallest weighted virtual runtime runs next,
+for a slice that shrinks as more processes are runnable
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int weights[]: weight of each process, CFS_DEFAULT_WEIGHT for all processes if NULL
+    int target_latency: time in milliseconds in which every runnable process runs once
+    int min_granularity: shortest slice in milliseconds
+Output: None
+*/
+void CompletelyFairScheduling(Process p[], int n, int weights[], int target_latency, int min_granularity){
     uint64_t scheduler_start_time = ms_time(0);
-    uint64_t last_boost_time = 0;
-    int queue_to_run;    // queue to run the process from
-    int proc_to_run[3] = {0, 0, 0};    // process to run from each queue
-    int status;
-    int res;
-
-    FILE *file = fopen("result_offline_MLFQ.csv", "w");
-    fprintf(file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-    fflush(file);
-
-    while (queue_size[0]+queue_size[1]+queue_size[2] > 0){
-
-        // boost all processes to the highest priority queue
-        if (ms_time(scheduler_start_time) - last_boost_time >= boostTime){
-            for (int i=1; i<3; i++){
-                for (int j=0; j<queue_size[i]; j++){
-                    queue[0][queue_size[0]++] = queue[i][j];
-                }
-                queue_size[i] = 0;
+    number_jobs(p, n);
+
+    // all processes start with the same virtual runtime and first run in index order
+    OfflineCfsState s = {.jobs = {p, n}};
+    cfs_init(&s.cfs, n, target_latency, min_granularity);
+    for (int i=0; i<n; i++){
+        cfs_add(&s.cfs, i, weights != NULL ? weights[i] : CFS_DEFAULT_WEIGHT);
+    }
+
+    run_scheduler(offline_cfs_policy, &s, "result_offline_CFS.csv", scheduler_start_time);
+    cfs_free(&s.cfs);
+}
+
+
+/* A logical cpu with its own multi-level run queue, pinned to one physical cpu */
+typedef struct {
+    pthread_mutex_t lock;
+    MultiLevelQueue queue;
+    int cpu;
+    uint64_t last_boost_time;
+    struct MultiCoreScheduler *scheduler;
+    pthread_t thread;
+} LogicalCpu;
+
+
+/* State shared by all logical cpus of a multi-core run */
+typedef struct MultiCoreScheduler {
+    Process *p;
+    int n;
+    LogicalCpu *cpus;
+    int num_cpus;
+    JobLinks links;    // shared by all cpus, each job is linked into one cpu's queue at a time
+    int num_levels;
+    int quantum[MAX_QUEUE_LEVELS];    // read atomically, the tuner changes them while the cpus run
+    uint64_t boost_time;
+    bool tuned;    // MLFQ runs follow mlfq_tuning, Round Robin keeps its slice
+    MlfqTuner tuner;    // shared by all cpus, under tune_lock
+    pthread_mutex_t tune_lock;
+    int *job_cpu;    // physical cpu each started process is currently pinned to
+    int num_done;
+    int num_queued;    // jobs in the queues of all cpus, idle cpus sleep while it is 0
+    int num_idle;    // cpus sleeping on idle_cond
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    uint64_t scheduler_start_time;
+    FILE *file;
+    ResultWriter writer;    // shared by all cpus
+} MultiCoreScheduler;
+
+
+/* Pin the given pid (0 for the calling thread) to a single physical cpu */
+void pin_to_cpu(pid_t pid, int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(pid, sizeof(set), &set);
+}
+
+
+/* Steal a job from the back of another logical cpu's highest non-empty queue, -1 if none */
+int steal_job(MultiCoreScheduler *s, LogicalCpu *self, int *level){
+    for (int k=1; k<s->num_cpus; k++){
+        LogicalCpu *victim = &s->cpus[(self - s->cpus + k) % s->num_cpus];
+        pthread_mutex_lock(&victim->lock);
+        for (int l=0; l<s->num_levels; l++){
+            int job = job_list_pop_back(&s->links, &victim->queue.level[l]);
+            if (job != -1){
+                pthread_mutex_unlock(&victim->lock);
+                *level = l;
+                return job;
             }
-            last_boost_time = ms_time(scheduler_start_time);
-            proc_to_run[2] = 0;
         }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return -1;
+}
+
+
+/*
+Sleep until a job is queued on some cpu or every job is done.
+num_idle is raised before num_queued is checked, and a cpu that queues a job raises num_queued
+before it checks num_idle, so one of the two always sees the other and no wake-up is lost.
+*/
+void multi_core_wait(MultiCoreScheduler *s){
+    pthread_mutex_lock(&s->idle_lock);
+    __atomic_add_fetch(&s->num_idle, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&s->num_queued, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&s->num_done, __ATOMIC_SEQ_CST) < s->n){
+        pthread_cond_wait(&s->idle_cond, &s->idle_lock);
+    }
+    __atomic_sub_fetch(&s->num_idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&s->idle_lock);
+}
+
+
+/* Wake one idle cpu to steal a job that was just queued, or all of them once every job is done */
+void multi_core_wake(MultiCoreScheduler *s, bool all){
+    if (__atomic_load_n(&s->num_idle, __ATOMIC_SEQ_CST) == 0){
+        return;
+    }
+    pthread_mutex_lock(&s->idle_lock);
+    if (all){
+        pthread_cond_broadcast(&s->idle_cond);
+    } else {
+        pthread_cond_signal(&s->idle_cond);
+    }
+    pthread_mutex_unlock(&s->idle_lock);
+}
+
+
+/* Feed the burst time of a completed job to the shared tuner, the cpus pick up the new slices at their next slice */
+void multi_core_tune(MultiCoreScheduler *s, Process *p){
+    pthread_mutex_lock(&s->tune_lock);
+    int quantum[MAX_QUEUE_LEVELS];
+    memcpy(quantum, s->quantum, sizeof(int) * s->num_levels);
+    uint64_t boost_time = s->boost_time;
+    mlfq_tuner_record(&s->tuner, s->num_levels, quantum, &boost_time, p->burst_time, p->completion_time);
+    for (int l=0; l<s->num_levels; l++){
+        __atomic_store_n(&s->quantum[l], quantum[l], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->boost_time, boost_time, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s->tune_lock);
+}
+
+
+/*
+Scheduling loop of one logical cpu: applies the boost, quantum and demotion rules of the
+single-core schedulers to its own queues and steals work from other cpus when idle
+*/
+void *logical_cpu_loop(void *arg){
+    LogicalCpu *self = arg;
+    MultiCoreScheduler *s = self->scheduler;
+    // processes forked from this thread inherit its affinity
+    pin_to_cpu(0, self->cpu);
+
+    while (__atomic_load_n(&s->num_done, __ATOMIC_ACQUIRE) < s->n){
+        int job = -1;
+        int level = 0;
+
+        pthread_mutex_lock(&self->lock);
+        if (s->num_levels > 1 && ms_time(s->scheduler_start_time) - self->last_boost_time >= __atomic_load_n(&s->boost_time, __ATOMIC_RELAXED)){
+            mlq_boost(&s->links, &self->queue);
+            self->last_boost_time = ms_time(s->scheduler_start_time);
+        }
+        job = mlq_pop_highest(&s->links, &self->queue, &level);
+        pthread_mutex_unlock(&self->lock);
 
-        // find the highest priority queue that is not empty
-        for (int i=0; i<3; i++){
-            if (queue_size[i] > 0){
-                queue_to_run = i;
-                break;
+        if (job == -1){
+            job = steal_job(s, self, &level);
+            if (job == -1){
+                // remaining jobs are running on other cpus
+                multi_core_wait(s);
+                continue;
             }
         }
+        __atomic_sub_fetch(&s->num_queued, 1, __ATOMIC_SEQ_CST);
 
-        Process *cp = &p[queue[queue_to_run][proc_to_run[queue_to_run]]];
-        res = run_process_for_quantum(cp, quantum[queue_to_run], scheduler_start_time, file);
+        Process *cp = &s->p[job];
+        if (cp->started && s->job_cpu[job] != self->cpu){
+            pin_to_cpu(cp->process_id, self->cpu);
+        }
+        s->job_cpu[job] = self->cpu;
+
+        int res = run_process_for_quantum(cp, __atomic_load_n(&s->quantum[level], __ATOMIC_RELAXED), s->scheduler_start_time, &s->writer);
         if (res <= 0){
-            // if process is finished or errored, remove it from the queue
-            for (int i = proc_to_run[queue_to_run]; i < queue_size[queue_to_run]-1; i++){
-                queue[queue_to_run][i] = queue[queue_to_run][i+1];
+            if (s->tuned && mlfq_tuning.enabled && !cp->error){
+                multi_core_tune(s, cp);
             }
-            queue_size[queue_to_run]--;
-            if (queue_size[queue_to_run]>=proc_to_run[queue_to_run]){
-                proc_to_run[queue_to_run] = 0;
+            if (__atomic_add_fetch(&s->num_done, 1, __ATOMIC_SEQ_CST) == s->n){
+                multi_core_wake(s, true);
             }
         } else {
-            // process used up the entire time slice
-            if (queue_to_run < 2){
-                // move the process to the next lower priority queue if present
-                queue[queue_to_run+1][queue_size[queue_to_run+1]++] = queue[queue_to_run][0];
-                for (int i = 0; i < queue_size[queue_to_run]-1; i++){
-                    queue[queue_to_run][i] = queue[queue_to_run][i+1];
-                }
-                queue_size[queue_to_run]--;
-            } else {
-                // if the process is already in the lowest priority queue, move to the next process
-                proc_to_run[2] = (proc_to_run[2]+1) % queue_size[queue_to_run];
-            }
+            // demote the process if it used the entire slice, the lowest queue is round robin
+            pthread_mutex_lock(&self->lock);
+            mlq_demote(&s->links, &self->queue, job, level);
+            pthread_mutex_unlock(&self->lock);
+            __atomic_add_fetch(&s->num_queued, 1, __ATOMIC_SEQ_CST);
+            multi_core_wake(s, false);
         }
     }
+    return NULL;
+}
 
-    fclose(file);
-    free(queue[0]);
-    free(queue[1]);
-    free(queue[2]);
+
+/*
+Distribute the processes over num_cpus logical cpus and run them until all are done
+Input:
+    MultiCoreScheduler *s: scheduler with p, n, num_levels, quantum and boost_time set
+    int num_cpus: number of logical cpus
+    const char *filename: result csv file
+*/
+void run_multi_core(MultiCoreScheduler *s, int num_cpus, const char *filename){
+    // map logical cpus onto the physical cpus this process is allowed to run on
+    cpu_set_t allowed;
+    int physical[CPU_SETSIZE];
+    int num_physical = 0;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int c=0; c<CPU_SETSIZE; c++){
+        if (CPU_ISSET(c, &allowed)){
+            physical[num_physical++] = c;
+        }
+    }
+    if (num_cpus < 1){
+        num_cpus = 1;
+    }
+
+    s->num_cpus = num_cpus;
+    s->cpus = calloc(num_cpus, sizeof(LogicalCpu));
+    s->job_cpu = malloc(sizeof(int) * (s->n > 0 ? s->n : 1));
+    job_links_init(&s->links, s->n);
+    s->num_done = 0;
+    s->num_queued = s->n;
+    s->num_idle = 0;
+    pthread_mutex_init(&s->idle_lock, NULL);
+    pthread_cond_init(&s->idle_cond, NULL);
+    pthread_mutex_init(&s->tune_lock, NULL);
+    memset(&s->tuner, 0, sizeof(s->tuner));
+    s->scheduler_start_time = ms_time(0);
+    s->file = fopen(filename, "w");
+    fprintf(s->file, RESULT_CSV_HEADER);
+    fflush(s->file);
+    writer_start(&s->writer, s->file, stdout);
+
+    for (int c=0; c<num_cpus; c++){
+        pthread_mutex_init(&s->cpus[c].lock, NULL);
+        s->cpus[c].cpu = num_physical > 0 ? physical[c % num_physical] : 0;
+        s->cpus[c].scheduler = s;
+        mlq_init(&s->cpus[c].queue, s->num_levels);
+    }
+    // initial placement in index order, the work stealing evens out the load afterwards
+    for (int i=0; i<s->n; i++){
+        s->p[i].job_id = i;
+        s->job_cpu[i] = -1;
+        job_list_push_back(&s->links, &s->cpus[i % num_cpus].queue.level[0], i);
+    }
+
+    for (int c=0; c<num_cpus; c++){
+        pthread_create(&s->cpus[c].thread, NULL, logical_cpu_loop, &s->cpus[c]);
+    }
+    for (int c=0; c<num_cpus; c++){
+        pthread_join(s->cpus[c].thread, NULL);
+        pthread_mutex_destroy(&s->cpus[c].lock);
+    }
+
+    job_output_stop();
+    writer_stop(&s->writer);
+    fclose(s->file);
+    pthread_mutex_destroy(&s->idle_lock);
+    pthread_cond_destroy(&s->idle_cond);
+    pthread_mutex_destroy(&s->tune_lock);
+    free(s->cpus);
+    free(s->job_cpu);
+    job_links_free(&s->links);
 }
 
+
+/*
+Round Robin Scheduling on multiple cpus: each logical cpu runs its own queue with a fixed time slice
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int quantum: time slice in milliseconds
+    int num_cpus: number of logical cpus
+Output: None
+*/
+void RoundRobinMultiCore(Process p[], int n, int quantum, int num_cpus){
+    MultiCoreScheduler s = {.p = p, .n = n, .num_levels = 1, .quantum = {quantum}};
+    run_multi_core(&s, num_cpus, "result_offline_RR.csv");
+}
+
+
+/*
+Multi-Level Feedback Queue Scheduling with any number of queues on every logical cpu
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int num_levels: number of queues, from 1 to MAX_QUEUE_LEVELS
+    int quantum[]: time slice of each queue, queue 0 having the highest priority
+    int boostTime: time after which all processes of a cpu are boosted to its highest priority queue
+    int num_cpus: number of logical cpus
+    the slices and boostTime are the starting point of the adaptive tuning if mlfq_tuning is enabled,
+    the completions of all cpus feed one tuner
+Output: None
+*/
+void MultiLevelFeedbackQueueLevelsMultiCore(Process p[], int n, int num_levels, int quantum[], int boostTime, int num_cpus){
+    if (!mlfq_levels_valid(num_levels)){
+        return;
+    }
+    MultiCoreScheduler s = {.p = p, .n = n, .num_levels = num_levels, .boost_time = boostTime, .tuned = true};
+    for (int l=0; l<num_levels; l++){
+        s.quantum[l] = quantum[l];
+    }
+    run_multi_core(&s, num_cpus, "result_offline_MLFQ.csv");
+}
+
+
+/*
+Multi-Level Feedback Queue Scheduling with 3 queues on every logical cpu
+Input:
+    Process p[]: array of processes
+    int n: number of processes
+    int quantum0: time slice for queue 0
+    int quantum1: time slice for queue 1
+    int quantum2: time slice for queue 2
+    int boostTime: time after which all processes of a cpu are boosted to its highest priority queue
+    int num_cpus: number of logical cpus
+Output: None
+*/
+void MultiLevelFeedbackQueueMultiCore(Process p[], int n, int quantum0, int quantum1, int quantum2, int boostTime, int num_cpus){
+    int quantum[3] = {quantum0, quantum1, quantum2};
+    MultiLevelFeedbackQueueLevelsMultiCore(p, n, 3, quantum, boostTime, num_cpus);
+}
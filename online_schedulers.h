@@ -1,72 +1,251 @@
 #pragma once
 
 #include "utils.h"
+#include "run_queue.h"
+#include "history_index.h"
+#include "job_heap.h"
+#include "intake.h"
+#include "scheduler_engine.h"
 
 #define DEFAULT_CAPACITY 100
 
+// bound on the number of command histories kept, least recently used ones are evicted beyond it
+#ifndef MAX_PROCESS_HISTORIES
+#define MAX_PROCESS_HISTORIES 1000000
+#endif
+
+// file the online schedulers keep their learned histories in across runs, such as "process_history.db",
+// NULL to start without any history and not persist it. Set it before starting a scheduler
+static const char *history_store_path = NULL;
+
+
+// weight of each command under the online CFS scheduler, NULL gives every command CFS_DEFAULT_WEIGHT
+static int (*cfs_command_weight)(const char *command) = NULL;
+
+
+// prediction errors of the last online scheduler run, to compare the burst predictors
+static PredictionStats online_prediction_stats;
+
+
+/* Growable array of process records whose indices stay valid until they are released */
 typedef struct {
-    char *command;
-    uint64_t avg_burst_time;
-    uint64_t history_size;
-} ProcessHistory;
+    Process *procs;
+    int *free_ids;
+    int num_free;
+    int size;
+    int capacity;
+} ProcessPool;
+
+
+void process_pool_init(ProcessPool *pool){
+    pool->capacity = DEFAULT_CAPACITY;
+    pool->procs = malloc(sizeof(Process) * pool->capacity);
+    pool->free_ids = malloc(sizeof(int) * pool->capacity);
+    pool->num_free = 0;
+    pool->size = 0;
+}
 
 
-/* append the given process in the given array of processes */
-void append_process(Process *processes, int *size, int *cap, Process *p){
-    if (*size >= *cap){
-        *cap *= 2;
-        processes = realloc(processes, sizeof(Process) * (*cap));
+/* store a copy of the given process in the pool and return its index */
+int process_pool_add(ProcessPool *pool, Process *p){
+    int id;
+    if (pool->num_free > 0){
+        id = pool->free_ids[--pool->num_free];
+    } else {
+        if (pool->size >= pool->capacity){
+            pool->capacity *= 2;
+            pool->procs = realloc(pool->procs, sizeof(Process) * pool->capacity);
+            pool->free_ids = realloc(pool->free_ids, sizeof(int) * pool->capacity);
+        }
+        id = pool->size++;
     }
-    processes[*size] = *p;
-    *size += 1;
+    pool->procs[id] = *p;
+    return id;
+}
+
+
+/* return the index of a completed process to the pool for reuse */
+void process_pool_release(ProcessPool *pool, int id){
+    pool->free_ids[pool->num_free++] = id;
+}
+
+
+void process_pool_free(ProcessPool *pool){
+    free(pool->procs);
+    free(pool->free_ids);
 }
 
 
-/* append the given process in the given array of process histories */
-void append_process_history(ProcessHistory *process_histories, int *size, int *cap, Process *p){
-    if (*size >= *cap){
-        *cap *= 2;
-        process_histories = realloc(process_histories, sizeof(ProcessHistory) * (*cap));
+/* Feed the cpu time of a completed process into the prediction of its command */
+void update_process_history(HistoryIndex *histories, Process *cp){
+    if (!cp->error){
+        history_record_burst(histories, cp->history_idx, cp->cpu_time);
     }
-    process_histories[*size].command = strdup(p->command);
-    process_histories[*size].avg_burst_time = 1000;
-    process_histories[*size].history_size = 0;
-    *size += 1;
+    history_index_unpin(histories, cp->history_idx);
 }
 
 
 /*
-Check the stdin for new processes and add them to the array of new_processes
+Create the pending process for a command taken from the intake queue and release the arrival.
+The command of the process is the string interned in its history, which stays pinned while the
+process is pending, so every pending instance of a command shares one copy.
 Input:
-    Process *new_processes: array of new processes
-    int *n: number of new processes
-    uint64_t scheduler_start_time: start time of the scheduler
+    HistoryIndex *histories: histories of the scheduler
+    Arrival *a: the arrival
+    bool *created: set to true if the command had no history, may be NULL
+Output:
+    the process, with its args and history_idx set
+*/
+Process process_from_arrival(HistoryIndex *histories, Arrival *a, bool *created){
+    Process p = {0};
+    p.history_idx = history_index_intern(histories, a->command, created);
+    history_index_pin(histories, p.history_idx);
+    p.command = history_at(histories, p.history_idx)->command;
+    p.arrival_time = a->arrival_time;
+    p.args = a->args;
+    p.job_id = a->job_id;
+    arrival_free(a);
+    return p;
+}
+
+
+/* Load the histories of previous runs and persist them from now on, false if the store is disabled or unusable */
+bool open_history_store(HistoryIndex *histories, HistoryStore *store){
+    if (history_store_path == NULL || !history_store_open(store, history_store_path, histories->predictor.kind)){
+        return false;
+    }
+    history_index_attach_store(histories, store);
+    return true;
+}
+
+
+void close_history_store(HistoryIndex *histories){
+    if (histories->store != NULL){
+        history_store_close(histories->store);
+        histories->store = NULL;
+    }
+}
+
+
+/*
+Pending processes ordered by the predicted remaining time of their command, shared by SJF and SRTF.
+The prediction is the predicted burst time of the command minus the cpu time the process already used.
+The pending instances of every history are linked, so they can be re-keyed when the history changes.
 */
-void check_for_new_processes(Process *new_processes, int *n, uint64_t scheduler_start_time){
-    int BUFFER_SIZE = 1000;
-    int capacity = DEFAULT_CAPACITY;
-    char command[BUFFER_SIZE];
-
-    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-
-    while (fgets(command, sizeof(command), stdin) != NULL){
-        size_t len = strlen(command);
-        if (len > 0 && command[len-1] == '\n'){
-            command[len-1] = '\0';
+typedef struct {
+    HistoryIndex histories;
+    HistoryStore store;
+    ProcessPool pool;
+    JobHeap heap;
+    JobLinks links;
+    JobList *pending;    // pending processes of each history slot
+    int pending_capacity;
+    uint64_t num_arrivals;
+} PredictedQueue;
+
+
+void predicted_queue_init(PredictedQueue *q){
+    history_index_init(&q->histories, MAX_PROCESS_HISTORIES, &burst_predictor);
+    open_history_store(&q->histories, &q->store);
+    process_pool_init(&q->pool);
+    job_heap_init(&q->heap, q->pool.capacity);
+    job_links_init(&q->links, q->pool.capacity);
+    q->pending_capacity = q->histories.capacity;
+    q->pending = malloc(sizeof(JobList) * q->pending_capacity);
+    for (int i=0; i<q->pending_capacity; i++){
+        job_list_init(&q->pending[i]);
+    }
+    q->num_arrivals = 0;
+}
+
+
+/* Predicted time the given process still has to run */
+uint64_t predicted_remaining_time(PredictedQueue *q, Process *p){
+    uint64_t predicted = history_at(&q->histories, p->history_idx)->predicted_burst_time;
+    return predicted > p->cpu_time ? predicted - p->cpu_time : 0;
+}
+
+
+/* Queue a process that was already added to the pool */
+void predicted_queue_push(PredictedQueue *q, int job, uint64_t seq){
+    Process *p = &q->pool.procs[job];
+    job_list_push_back(&q->links, &q->pending[p->history_idx], job);
+    job_heap_push(&q->heap, job, predicted_remaining_time(q, p), seq);
+}
+
+
+/* Add a newly arrived process, created by process_from_arrival */
+void predicted_queue_add(PredictedQueue *q, Process *p){
+    if (q->histories.capacity > q->pending_capacity){
+        q->pending = realloc(q->pending, sizeof(JobList) * q->histories.capacity);
+        for (int i=q->pending_capacity; i<q->histories.capacity; i++){
+            job_list_init(&q->pending[i]);
         }
+        q->pending_capacity = q->histories.capacity;
+    }
+
+    int job = process_pool_add(&q->pool, p);
+    job_links_reserve(&q->links, q->pool.capacity);
+    job_heap_reserve(&q->heap, q->pool.capacity);
+    predicted_queue_push(q, job, q->num_arrivals++);
+}
 
-        Process p;
-        p.command = strdup(command);
-        p.arrival_time = ms_time(scheduler_start_time);
-        append_process(new_processes, n, &capacity, &p);
 
-        usleep(10000);
-        if (feof(stdin)){
-            break;
+/* Remove and return the process with the shortest predicted remaining time, -1 if none */
+int predicted_queue_pop(PredictedQueue *q){
+    int job = job_heap_pop(&q->heap);
+    if (job != -1){
+        job_list_remove(&q->links, &q->pending[q->pool.procs[job].history_idx], job);
+    }
+    return job;
+}
+
+
+/* Update the history with a completed process, re-key the pending instances of its command and release it */
+void predicted_queue_complete(PredictedQueue *q, int job){
+    Process *cp = &q->pool.procs[job];
+    int history_idx = cp->history_idx;
+    uint64_t old_prediction = history_at(&q->histories, history_idx)->predicted_burst_time;
+    update_process_history(&q->histories, cp);
+    if (history_at(&q->histories, history_idx)->predicted_burst_time != old_prediction){
+        for (int j=q->pending[history_idx].head; j!=-1; j=q->links.next[j]){
+            job_heap_update(&q->heap, j, predicted_remaining_time(q, &q->pool.procs[j]));
         }
     }
-    fcntl(STDIN_FILENO, F_SETFL, flags);
+    process_pool_release(&q->pool, job);
+}
+
+
+/* Move every arrival published by the intake thread into the queue */
+void predicted_queue_take_arrivals(PredictedQueue *q, ArrivalQueue *intake){
+    Arrival *arrival;
+    while ((arrival = intake_pop(intake)) != NULL){
+        Process new_process = process_from_arrival(&q->histories, arrival, NULL);
+        predicted_queue_add(q, &new_process);
+    }
+}
+
+
+/* Publish the live metrics of SJF or SRTF, at most every LIVE_METRICS_INTERVAL_MS unless forced */
+void predicted_queue_publish(PredictedQueue *q, ArrivalQueue *intake, LiveMetrics *m, uint64_t now, bool force){
+    if (m->segment == NULL || (!force && now - m->last_publish < LIVE_METRICS_INTERVAL_MS)){
+        return;
+    }
+    m->last.pending = q->heap.size;
+    m->last.history_size = q->histories.size;
+    // counted on the intake thread
+    m->last.arrivals = __atomic_load_n(&intake->num_lines, __ATOMIC_RELAXED);
+    live_metrics_publish(m, now);
+}
+
+
+void predicted_queue_free(PredictedQueue *q){
+    close_history_store(&q->histories);
+    history_index_free(&q->histories);
+    process_pool_free(&q->pool);
+    job_heap_free(&q->heap);
+    job_links_free(&q->links);
+    free(q->pending);
 }
 
 
@@ -74,88 +253,280 @@ void check_for_new_processes(Process *new_processes, int *n, uint64_t scheduler_
 Shortest Job First (SJF) Scheduling
 */
 void ShortestJobFirst(){
-    // array of ProcessHistory to store the history of each process
-    int history_capacity = DEFAULT_CAPACITY;
-    ProcessHistory *process_histories = malloc(sizeof(ProcessHistory) * history_capacity);
-    int num_process_histories = 0;
-
-    // array of Process to store the pending processes
-    int process_capacity = DEFAULT_CAPACITY;
-    Process *processes = malloc(sizeof(Process) * process_capacity);
-    int num_processes = 0;
+    // pending processes ordered by the predicted burst time of their command
+    PredictedQueue queue;
+    predicted_queue_init(&queue);
 
     uint64_t scheduler_start_time = ms_time(0);
     FILE *file = fopen("result_online_SJF.csv", "w");
-    fprintf(file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
+    fprintf(file, RESULT_CSV_HEADER);
     fflush(file);
+    ResultWriter writer;
+    writer_start(&writer, file, stdout);
+
+    // commands are read and stamped on the intake thread, also while a process is running
+    ArrivalQueue intake;
+    intake_start(&intake, STDIN_FILENO, scheduler_start_time);
+    LiveMetrics metrics;
+    live_metrics_open(&metrics, "result_online_SJF.csv");
 
     while (1){
-        // get new processes
-        Process *new_processes = malloc(sizeof(Process) * DEFAULT_CAPACITY);
-        int num_new_processes = 0;
-        check_for_new_processes(new_processes, &num_new_processes, scheduler_start_time);
-        
-        // for each new process, check if it is already in the history, if not add it to the history
-        for (int i=0; i<num_new_processes; i++){
-            int history_idx = -1;
-            for (int j=0; j<num_process_histories; j++){
-                if (strcmp(process_histories[j].command, new_processes[i].command) == 0){
-                    history_idx = j;
-                    break;
-                }
-            }
-            if (history_idx == -1){
-                history_idx = num_process_histories;
-                append_process_history(process_histories, &num_process_histories, &history_capacity, &new_processes[i]);
+        bool input_closed = intake_closed(&intake);
+        predicted_queue_take_arrivals(&queue, &intake);
+
+        // sleep until new commands arrive, stop once the input is closed and everything ran
+        if (queue.heap.size == 0){
+            if (input_closed){
+                break;
             }
-            new_processes[i].history_idx = history_idx;
+            predicted_queue_publish(&queue, &intake, &metrics, ms_time(scheduler_start_time), true);
+            intake_wait(&intake);
+            continue;
         }
 
-        // add new processes to the array of processes
-        if (num_new_processes+num_processes >= process_capacity){
-            process_capacity = num_new_processes+num_processes;
-            processes = realloc(processes, sizeof(Process) * process_capacity);
-        }
-        for (int i=0; i<num_new_processes; i++){
-            processes[num_processes++] = new_processes[i];
+        // run the process with the shortest predicted burst time, then update its history
+        int job = predicted_queue_pop(&queue);
+        Process *cp = &queue.pool.procs[job];
+        run_process_completely(cp, scheduler_start_time, &writer);
+        if (metrics.segment != NULL){
+            live_metrics_complete(&metrics, cp);
         }
+        predicted_queue_complete(&queue, job);
+        predicted_queue_publish(&queue, &intake, &metrics, ms_time(scheduler_start_time), false);
+    }
 
-        free(new_processes);
+    live_metrics_close(&metrics);
+    intake_stop(&intake);
+    job_output_stop();
+    writer_stop(&writer);
+    fclose(file);
+    online_prediction_stats = queue.histories.stats;
+    predicted_queue_free(&queue);
+}
+
+
+/*
+Shortest Remaining Time First (SRTF) Scheduling: preemptive SJF.
+A process runs until it exits or a new process arrives whose predicted burst time is shorter than
+the predicted remaining time of the running one, which is then stopped and queued again.
+*/
+void ShortestRemainingTimeFirst(){
+    // pending and preempted processes ordered by their predicted remaining time
+    PredictedQueue queue;
+    predicted_queue_init(&queue);
+
+    uint64_t scheduler_start_time = ms_time(0);
+    FILE *file = fopen("result_online_SRTF.csv", "w");
+    fprintf(file, RESULT_CSV_HEADER);
+    fflush(file);
+    ResultWriter writer;
+    writer_start(&writer, file, stdout);
+
+    ArrivalQueue intake;
+    intake_start(&intake, STDIN_FILENO, scheduler_start_time);
+    LiveMetrics metrics;
+    live_metrics_open(&metrics, "result_online_SRTF.csv");
+
+    while (1){
+        bool input_closed = intake_closed(&intake);
+        predicted_queue_take_arrivals(&queue, &intake);
 
-        // find the process with the shortest avg burst time
-        int shortest_burst_time = INT_MAX;
-        int shortest_burst_time_index = -1;
-        for (int i=0; i<num_processes; i++){
-            ProcessHistory *cph = &process_histories[processes[i].history_idx];
-            if (cph->avg_burst_time < shortest_burst_time){
-                shortest_burst_time = cph->avg_burst_time;
-                shortest_burst_time_index = i;
+        if (queue.heap.size == 0){
+            if (input_closed){
+                break;
             }
+            predicted_queue_publish(&queue, &intake, &metrics, ms_time(scheduler_start_time), true);
+            intake_wait(&intake);
+            continue;
+        }
+
+        int job = predicted_queue_pop(&queue);
+        Process *cp = &queue.pool.procs[job];
+        uint64_t context_start_time = ms_time(scheduler_start_time);
+        if (!cp->started){
+            start_process(cp, scheduler_start_time);
+        } else {
+            resume_process(cp);
         }
 
-        // run the process with the shortest avg burst time
-        if (shortest_burst_time_index != -1){
-            Process *cp = &processes[shortest_burst_time_index];
-            run_process_completely(cp, scheduler_start_time, file);
-            
-            // update the average burst time of the process in the history
+        while (1){
             if (!cp->error){
-                ProcessHistory *cph = &process_histories[cp->history_idx];
-                cph->avg_burst_time = (cph->avg_burst_time * cph->history_size + cp->burst_time) / (cph->history_size + 1);
-                cph->history_size++;
+                // wake up when the process exits or new processes arrive
+                wait_for_slice(cp, -1, intake.event_fd);
+                reap_process(cp, WNOHANG, scheduler_start_time);
+            }
+
+            if (cp->finished || cp->error){
+                cp->burst_time += cp->completion_time - context_start_time;
+                cp->turnaround_time = cp->completion_time - cp->arrival_time;
+                cp->waiting_time = cp->turnaround_time - cp->burst_time;
+                write_result(&writer, cp);
+                context_switch_output(&writer, cp, context_start_time, cp->completion_time);
+                if (metrics.segment != NULL){
+                    live_metrics_complete(&metrics, cp);
+                }
+                predicted_queue_complete(&queue, job);
+                break;
             }
 
-            // remove the process from the array of processes
-            for (int i=shortest_burst_time_index; i<num_processes-1; i++){
-                processes[i] = processes[i+1];
+            // preempt if a new arrival is predicted to finish before the running process
+            intake_clear(&intake);
+            predicted_queue_take_arrivals(&queue, &intake);
+            // the arrivals may have grown the pool and moved its processes
+            cp = &queue.pool.procs[job];
+            uint64_t now = ms_time(scheduler_start_time);
+            uint64_t predicted = history_at(&queue.histories, cp->history_idx)->predicted_burst_time;
+            uint64_t cpu_time = process_cpu_time(cp);
+            uint64_t remaining = predicted > cpu_time ? predicted - cpu_time : 0;
+            if (queue.heap.size > 0 && queue.heap.key[queue.heap.heap[0]] < remaining){
+                pause_process(cp);
+                cp->burst_time += now - context_start_time;
+                cp->cpu_time = process_cpu_time(cp);
+                context_switch_output(&writer, cp, context_start_time, now);
+                predicted_queue_push(&queue, job, queue.num_arrivals++);
+                break;
             }
-            num_processes--;
         }
+        predicted_queue_publish(&queue, &intake, &metrics, ms_time(scheduler_start_time), false);
     }
 
+    live_metrics_close(&metrics);
+    intake_stop(&intake);
+    job_output_stop();
+    writer_stop(&writer);
     fclose(file);
-    free(process_histories);
-    free(processes);
+    online_prediction_stats = queue.histories.stats;
+    predicted_queue_free(&queue);
+}
+
+
+/* Online multi-level feedback queue: pending processes live in the pool, the queues link their indices */
+typedef struct {
+    MlfqState mlfq;
+    HistoryIndex histories;
+    ProcessPool pool;
+    ArrivalQueue intake;
+    bool input_closed;
+} OnlineMlfqState;
+
+
+/* Level of a new process: the first level whose slice exceeds its prediction, level 1 without history */
+int online_mlfq_level(MlfqState *mlfq, ProcessHistory *history, bool created){
+    int num_levels = mlfq->queue.num_levels;
+    if (created){
+        return num_levels > 1 ? 1 : 0;
+    }
+    for (int l=0; l<num_levels-1; l++){
+        if (history->predicted_burst_time < (uint64_t)mlfq->quantum[l]){
+            return l;
+        }
+    }
+    return num_levels - 1;
+}
+
+
+int online_mlfq_pick(void *state, uint64_t now, int *quantum){
+    OnlineMlfqState *s = state;
+    s->input_closed = intake_closed(&s->intake);
+
+    // for each new process, find its history or add a new one, pinned while the process is pending
+    Arrival *arrival;
+    while ((arrival = intake_pop(&s->intake)) != NULL){
+        bool created;
+        Process new_process = process_from_arrival(&s->histories, arrival, &created);
+        int level = online_mlfq_level(&s->mlfq, history_at(&s->histories, new_process.history_idx), created);
+        int job = process_pool_add(&s->pool, &new_process);
+        job_links_reserve(&s->mlfq.links, s->pool.capacity);
+        mlfq_add(&s->mlfq, job, level);
+    }
+    return mlfq_pick(&s->mlfq, now, quantum);
+}
+
+
+void online_mlfq_requeue(void *state, int job){
+    mlfq_requeue(&((OnlineMlfqState *)state)->mlfq, job);
+}
+
+
+/* The process finished or errored, update the prediction of its command and release it */
+void online_mlfq_complete(void *state, int job){
+    OnlineMlfqState *s = state;
+    Process *cp = &s->pool.procs[job];
+    mlfq_complete(&s->mlfq, cp);
+    update_process_history(&s->histories, cp);
+    process_pool_release(&s->pool, job);
+}
+
+
+/* Sleep until new commands arrive, stop once the input is closed and everything ran */
+bool online_mlfq_wait(void *state){
+    OnlineMlfqState *s = state;
+    if (s->input_closed){
+        return false;
+    }
+    intake_wait(&s->intake);
+    return true;
+}
+
+
+Process *online_mlfq_process(void *state, int job){
+    return &((OnlineMlfqState *)state)->pool.procs[job];
+}
+
+
+void online_mlfq_metrics(void *state, LiveSnapshot *snapshot){
+    OnlineMlfqState *s = state;
+    mlfq_metrics(&s->mlfq, snapshot);
+    snapshot->history_size = s->histories.size;
+    // counted on the intake thread
+    snapshot->arrivals = __atomic_load_n(&s->intake.num_lines, __ATOMIC_RELAXED);
+}
+
+
+static const SchedulerPolicy online_mlfq_policy = {
+    .pick = online_mlfq_pick,
+    .requeue = online_mlfq_requeue,
+    .complete = online_mlfq_complete,
+    .wait = online_mlfq_wait,
+    .process = online_mlfq_process,
+    .metrics = online_mlfq_metrics
+};
+
+
+/*
+Multi-Level Feedback Queue Scheduling with any number of queues
+Input:
+    int num_levels: number of queues, from 1 to MAX_QUEUE_LEVELS
+    int quantum[]: time slice of each queue, queue 0 having the highest priority
+    int boostTime: time after which all processes are boosted to the highest priority queue
+    the slices and boostTime are the starting point of the adaptive tuning if mlfq_tuning is enabled
+*/
+void MultiLevelFeedbackQueueLevels(int num_levels, int quantum[], int boostTime){
+    if (!mlfq_levels_valid(num_levels)){
+        return;
+    }
+    OnlineMlfqState s;
+
+    // history of each command, indexed by the command string
+    history_index_init(&s.histories, MAX_PROCESS_HISTORIES, &burst_predictor);
+    HistoryStore store;
+    open_history_store(&s.histories, &store);
+    process_pool_init(&s.pool);
+    mlfq_init(&s.mlfq, s.pool.capacity, num_levels, quantum, boostTime);
+    s.input_closed = false;
+
+    // commands are read and stamped on the intake thread, also while a process is running
+    uint64_t scheduler_start_time = ms_time(0);
+    intake_start(&s.intake, STDIN_FILENO, scheduler_start_time);
+
+    run_scheduler(online_mlfq_policy, &s, "result_online_MLFQ.csv", scheduler_start_time);
+
+    intake_stop(&s.intake);
+    online_prediction_stats = s.histories.stats;
+    close_history_store(&s.histories);
+    history_index_free(&s.histories);
+    process_pool_free(&s.pool);
+    mlfq_free(&s.mlfq);
 }
 
 
@@ -168,129 +539,111 @@ Input:
     int boostTime: time after which all processes are boosted to the highest priority queue
 */
 void MultiLevelFeedbackQueue(int quantum0, int quantum1, int quantum2, int boostTime){
+    int quantum[3] = {quantum0, quantum1, quantum2};
+    MultiLevelFeedbackQueueLevels(3, quantum, boostTime);
+}
 
-    // array of ProcessHistory to store the history of each process
-    int history_capacity = DEFAULT_CAPACITY;
-    ProcessHistory *process_histories = malloc(sizeof(ProcessHistory) * history_capacity);
-    int num_process_histories = 0;
 
-    // 3 queues for the pending processes
-    int queue_capacity[3] = {DEFAULT_CAPACITY, DEFAULT_CAPACITY, DEFAULT_CAPACITY};
-    Process **queue = malloc(sizeof(Process *) * 3);
-    for (int i=0; i<3; i++){
-        queue[i] = malloc(sizeof(Process) * queue_capacity[i]);
+/* Online completely fair scheduler: pending processes live in the pool, the tree orders their indices */
+typedef struct {
+    CfsState cfs;
+    HistoryIndex histories;
+    ProcessPool pool;
+    ArrivalQueue intake;
+    bool input_closed;
+} OnlineCfsState;
+
+
+int online_cfs_pick(void *state, uint64_t now, int *quantum){
+    OnlineCfsState *s = state;
+    s->input_closed = intake_closed(&s->intake);
+
+    // new processes start from the smallest virtual runtime, their histories stay pinned while they are pending
+    Arrival *arrival;
+    while ((arrival = intake_pop(&s->intake)) != NULL){
+        Process new_process = process_from_arrival(&s->histories, arrival, NULL);
+        int weight = cfs_command_weight != NULL ? cfs_command_weight(new_process.command) : CFS_DEFAULT_WEIGHT;
+        int job = process_pool_add(&s->pool, &new_process);
+        cfs_reserve(&s->cfs, s->pool.capacity);
+        cfs_add(&s->cfs, job, weight);
     }
-    int queue_size[3] = {0, 0, 0};
+    return cfs_pick(&s->cfs, s->pool.procs, quantum);
+}
 
-    int quantum[3] = {quantum0, quantum1, quantum2};
-    int queue_to_run;
-    int proc_to_run[3] = {0, 0, 0};
 
-    uint64_t scheduler_start_time = ms_time(0);
-    uint64_t last_boost_time = 0;
-    FILE *file = fopen("result_online_MLFQ.csv", "w");
-    fprintf(file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-    fflush(file);
+void online_cfs_requeue(void *state, int job){
+    OnlineCfsState *s = state;
+    cfs_requeue(&s->cfs, s->pool.procs, job);
+}
 
-    while (1){
-        // get new processes
-        Process *new_processes = malloc(sizeof(Process) * DEFAULT_CAPACITY);
-        int num_new_processes = 0;
-        check_for_new_processes(new_processes, &num_new_processes, scheduler_start_time);
-
-        // for each new process, check if it is already in the history, if not add it to the history
-        for (int i=0; i<num_new_processes; i++){
-            int history_idx = -1;
-            int queue_idx = 1;
-            for (int j=0; j<num_process_histories; j++){
-                if (strcmp(process_histories[j].command, new_processes[i].command) == 0){
-                    history_idx = j;
-                    break;
-                }
-            }
-            if (history_idx == -1){
-                new_processes[i].history_idx = num_process_histories;
-                append_process_history(process_histories, &num_process_histories, &history_capacity, &new_processes[i]);
-            } else {
-                new_processes[i].history_idx = history_idx;
-                if (process_histories[history_idx].avg_burst_time < quantum[0]){
-                    queue_idx = 0;
-                } else if (process_histories[history_idx].avg_burst_time < quantum[1]){
-                    queue_idx = 1;
-                } else {
-                    queue_idx = 2;
-                }
-            }
-            append_process(queue[queue_idx], &queue_size[queue_idx], &queue_capacity[queue_idx], &new_processes[i]);
-        }
-        
-        free(new_processes);
-
-        // boost all processes to the highest priority queue
-        if (ms_time(scheduler_start_time) - last_boost_time >= boostTime){
-            if (queue_size[0]+queue_size[1]+queue_size[2] > queue_capacity[0]){
-                queue_capacity[0] = queue_size[0]+queue_size[1]+queue_size[2];
-                queue[0] = realloc(queue[0], sizeof(Process) * queue_capacity[0]);
-            }
-            for (int i=1; i<3; i++){
-                for (int j=0; j<queue_size[i]; j++){
-                    queue[0][queue_size[0]++] = queue[i][j];
-                }
-                queue_size[i] = 0;
-            }
-            last_boost_time = ms_time(scheduler_start_time);
-            proc_to_run[2] = 0;
-        }
 
-        // find the highest priority queue that is not empty
-        queue_to_run = -1;
-        for (int i=0; i<3; i++){
-            if (queue_size[i] > 0){
-                queue_to_run = i;
-                break;
-            }
-        }
+/* The process finished or errored, update the prediction of its command and release it */
+void online_cfs_complete(void *state, int job){
+    OnlineCfsState *s = state;
+    Process *cp = &s->pool.procs[job];
+    cfs_complete(&s->cfs, job);
+    update_process_history(&s->histories, cp);
+    process_pool_release(&s->pool, job);
+}
 
-        if (queue_to_run != -1){
-            Process *cp = &queue[queue_to_run][proc_to_run[queue_to_run]];
-            int res = run_process_for_quantum(cp, quantum[queue_to_run], scheduler_start_time, file);
 
-            if (res <= 0){
-                // if process is finished or errored, update the average burst time in the history and remove it from the queue
-                if (!cp->error){
-                    ProcessHistory *cph = &process_histories[cp->history_idx];
-                    cph->avg_burst_time = (cph->avg_burst_time * cph->history_size + cp->burst_time) / (cph->history_size + 1);
-                    cph->history_size++;
-                }
+bool online_cfs_wait(void *state){
+    OnlineCfsState *s = state;
+    if (s->input_closed){
+        return false;
+    }
+    intake_wait(&s->intake);
+    return true;
+}
 
-                for (int i=proc_to_run[queue_to_run]; i<queue_size[queue_to_run]-1; i++){
-                    queue[queue_to_run][i] = queue[queue_to_run][i+1];
-                }
-                queue_size[queue_to_run]--;
 
-                if (queue_size[queue_to_run] >= proc_to_run[queue_to_run]){
-                    proc_to_run[queue_to_run] = 0;
-                }
-            } else {
-                // process used up the entire time slice
-                if (queue_to_run < 2){
-                    // move the process to the next lower priority queue if present
-                    append_process(queue[queue_to_run+1], &queue_size[queue_to_run+1], &queue_capacity[queue_to_run+1], cp);
-                    for (int i=0; i<queue_size[queue_to_run]-1; i++){
-                        queue[queue_to_run][i] = queue[queue_to_run][i+1];
-                    }
-                    queue_size[queue_to_run]--;
-                } else {
-                    // if the process is already in the lowest priority queue, move to the next process
-                    proc_to_run[2] = (proc_to_run[2]+1) % queue_size[queue_to_run];
-                }
-            }
-        }
-    }
+Process *online_cfs_process(void *state, int job){
+    return &((OnlineCfsState *)state)->pool.procs[job];
+}
 
-    fclose(file);
-    free(process_histories);
-    free(queue[0]);
-    free(queue[1]);
-    free(queue[2]);
+
+void online_cfs_metrics(void *state, LiveSnapshot *snapshot){
+    OnlineCfsState *s = state;
+    snapshot->pending = s->cfs.num_runnable;
+    snapshot->history_size = s->histories.size;
+    snapshot->arrivals = __atomic_load_n(&s->intake.num_lines, __ATOMIC_RELAXED);
+}
+
+
+static const SchedulerPolicy online_cfs_policy = {
+    .pick = online_cfs_pick,
+    .requeue = online_cfs_requeue,
+    .complete = online_cfs_complete,
+    .wait = online_cfs_wait,
+    .process = online_cfs_process,
+    .metrics = online_cfs_metrics
+};
+
+
+/*
+Completely Fair Scheduling of the commands read from stdin, weighted by cfs_command_weight
+Input:
+    int target_latency: time in milliseconds in which every runnable process runs once
+    int min_granularity: shortest slice in milliseconds
+*/
+void CompletelyFairScheduling(int target_latency, int min_granularity){
+    OnlineCfsState s;
+    history_index_init(&s.histories, MAX_PROCESS_HISTORIES, &burst_predictor);
+    HistoryStore store;
+    open_history_store(&s.histories, &store);
+    process_pool_init(&s.pool);
+    cfs_init(&s.cfs, s.pool.capacity, target_latency, min_granularity);
+    s.input_closed = false;
+
+    uint64_t scheduler_start_time = ms_time(0);
+    intake_start(&s.intake, STDIN_FILENO, scheduler_start_time);
+
+    run_scheduler(online_cfs_policy, &s, "result_online_CFS.csv", scheduler_start_time);
+
+    intake_stop(&s.intake);
+    online_prediction_stats = s.histories.stats;
+    close_history_store(&s.histories);
+    history_index_free(&s.histories);
+    process_pool_free(&s.pool);
+    cfs_free(&s.cfs);
 }
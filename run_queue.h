@@ -0,0 +1,205 @@
+#pragma once
+
+#include <stdlib.h>
+
+#define MAX_QUEUE_LEVELS 8
+
+
+/*
+Intrusive run queues of process indices shared by the offline and online schedulers.
+Every process index owns one next/prev slot in JobLinks, so a process can be in at most one
+JobList at a time and enqueue, dequeue, removal and splicing a whole list are all O(1).
+*/
+typedef struct {
+    int *next;
+    int *prev;
+    int capacity;
+} JobLinks;
+
+
+/* Doubly linked list of process indices threaded through a JobLinks */
+typedef struct {
+    int head;
+    int tail;
+    int size;
+} JobList;
+
+
+/* Fixed set of priority levels, level 0 being the highest priority */
+typedef struct {
+    JobList level[MAX_QUEUE_LEVELS];
+    int num_levels;
+} MultiLevelQueue;
+
+
+void job_links_init(JobLinks *links, int capacity){
+    links->capacity = capacity > 0 ? capacity : 1;
+    links->next = malloc(sizeof(int) * links->capacity);
+    links->prev = malloc(sizeof(int) * links->capacity);
+}
+
+
+/* Grow the links so that process indices below capacity can be queued */
+void job_links_reserve(JobLinks *links, int capacity){
+    if (capacity <= links->capacity){
+        return;
+    }
+    int new_capacity = links->capacity;
+    while (new_capacity < capacity){
+        new_capacity *= 2;
+    }
+    links->next = realloc(links->next, sizeof(int) * new_capacity);
+    links->prev = realloc(links->prev, sizeof(int) * new_capacity);
+    links->capacity = new_capacity;
+}
+
+
+void job_links_free(JobLinks *links){
+    free(links->next);
+    free(links->prev);
+    links->next = NULL;
+    links->prev = NULL;
+    links->capacity = 0;
+}
+
+
+void job_list_init(JobList *list){
+    list->head = -1;
+    list->tail = -1;
+    list->size = 0;
+}
+
+
+void job_list_push_back(JobLinks *links, JobList *list, int job){
+    links->next[job] = -1;
+    links->prev[job] = list->tail;
+    if (list->tail == -1){
+        list->head = job;
+    } else {
+        links->next[list->tail] = job;
+    }
+    list->tail = job;
+    list->size++;
+}
+
+
+void job_list_push_front(JobLinks *links, JobList *list, int job){
+    links->prev[job] = -1;
+    links->next[job] = list->head;
+    if (list->head == -1){
+        list->tail = job;
+    } else {
+        links->prev[list->head] = job;
+    }
+    list->head = job;
+    list->size++;
+}
+
+
+/* Unlink the given process from the list it is in */
+void job_list_remove(JobLinks *links, JobList *list, int job){
+    int prev = links->prev[job];
+    int next = links->next[job];
+    if (prev == -1){
+        list->head = next;
+    } else {
+        links->next[prev] = next;
+    }
+    if (next == -1){
+        list->tail = prev;
+    } else {
+        links->prev[next] = prev;
+    }
+    list->size--;
+}
+
+
+/* Remove and return the process at the front of the list, -1 if empty */
+int job_list_pop_front(JobLinks *links, JobList *list){
+    int job = list->head;
+    if (job != -1){
+        job_list_remove(links, list, job);
+    }
+    return job;
+}
+
+
+/* Remove and return the process at the back of the list, -1 if empty */
+int job_list_pop_back(JobLinks *links, JobList *list){
+    int job = list->tail;
+    if (job != -1){
+        job_list_remove(links, list, job);
+    }
+    return job;
+}
+
+
+/* Move every process of src to the back of dst, keeping their order */
+void job_list_splice(JobLinks *links, JobList *dst, JobList *src){
+    if (src->size == 0){
+        return;
+    }
+    if (dst->size == 0){
+        *dst = *src;
+    } else {
+        links->next[dst->tail] = src->head;
+        links->prev[src->head] = dst->tail;
+        dst->tail = src->tail;
+        dst->size += src->size;
+    }
+    job_list_init(src);
+}
+
+
+void mlq_init(MultiLevelQueue *q, int num_levels){
+    q->num_levels = num_levels;
+    for (int i=0; i<MAX_QUEUE_LEVELS; i++){
+        job_list_init(&q->level[i]);
+    }
+}
+
+
+/* Total number of processes queued over all levels */
+int mlq_size(MultiLevelQueue *q){
+    int size = 0;
+    for (int i=0; i<q->num_levels; i++){
+        size += q->level[i].size;
+    }
+    return size;
+}
+
+
+/*
+Remove and return the front process of the highest priority non-empty level
+Input:
+    JobLinks *links: links of the process indices
+    MultiLevelQueue *q: the queue
+    int *level: set to the level the process was taken from
+Output:
+    index of the process, -1 if every level is empty
+*/
+int mlq_pop_highest(JobLinks *links, MultiLevelQueue *q, int *level){
+    *level = 0;
+    for (int i=0; i<q->num_levels; i++){
+        if (q->level[i].size > 0){
+            *level = i;
+            return job_list_pop_front(links, &q->level[i]);
+        }
+    }
+    return -1;
+}
+
+
+/* Requeue a process that used up its slice one level lower, the lowest level is round robin */
+void mlq_demote(JobLinks *links, MultiLevelQueue *q, int job, int level){
+    int next_level = level+1 < q->num_levels ? level+1 : level;
+    job_list_push_back(links, &q->level[next_level], job);
+}
+
+
+/* Move all processes to the highest priority level by splicing the lower levels behind it */
+void mlq_boost(JobLinks *links, MultiLevelQueue *q){
+    for (int i=1; i<q->num_levels; i++){
+        job_list_splice(links, &q->level[0], &q->level[i]);
+    }
+}
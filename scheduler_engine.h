@@ -0,0 +1,327 @@
+#pragma once
+
+#include "utils.h"
+#include "run_queue.h"
+#include "job_tree.h"
+#include "mlfq_tuning.h"
+#include "live_metrics.h"
+
+// weight of a job with no weight given, virtual runtimes are in time of a job of this weight
+#define CFS_DEFAULT_WEIGHT 1024
+
+
+/*
+Scheduling policy run by the scheduler engine. The engine asks the policy for the next job and its
+time slice, runs it, and hands it back as completed or as having used up its slice.
+Policies are passed as constant structs to run_scheduler, which is always inlined: the compiler
+then sees the function each pointer refers to and calls the hooks directly, or inlines them, the
+same as the hand-written loops of the schedulers did.
+*/
+typedef struct {
+    // next job to run and its time slice in milliseconds (-1 to run it to completion), -1 if none is runnable
+    int (*pick)(void *state, uint64_t now, int *quantum);
+    // the job used up its time slice
+    void (*requeue)(void *state, int job);
+    // the job finished or errored, NULL if the policy keeps no per-job state
+    void (*complete)(void *state, int job);
+    // no job is runnable: block until one may be, false once no more will come. NULL ends the run
+    bool (*wait)(void *state);
+    // process record of the job
+    Process *(*process)(void *state, int job);
+    // fill in the pending jobs and arrivals of a live snapshot, and the queue levels and history size
+    // where the policy has them. NULL publishes no live metrics
+    void (*metrics)(void *state, LiveSnapshot *snapshot);
+} SchedulerPolicy;
+
+
+/* Hand the state of the policy to the live metrics and publish them */
+static inline __attribute__((always_inline))
+void publish_metrics(const SchedulerPolicy policy, void *state, LiveMetrics *metrics, uint64_t now){
+    policy.metrics(state, &metrics->last);
+    live_metrics_publish(metrics, now);
+}
+
+
+/*
+Run jobs under the given policy until it has none left, writing the result csv and context switches
+Input:
+    const SchedulerPolicy policy: the policy, a compile-time constant
+    void *state: state of the policy
+    const char *filename: result csv file
+    uint64_t scheduler_start_time: start time of the scheduler
+*/
+static inline __attribute__((always_inline))
+void run_scheduler(const SchedulerPolicy policy, void *state, const char *filename, uint64_t scheduler_start_time){
+    FILE *file = fopen(filename, "w");
+    fprintf(file, RESULT_CSV_HEADER);
+    fflush(file);
+    ResultWriter writer;
+    writer_start(&writer, file, stdout);
+    // the loop only counts while metrics are published, see live_metrics.h
+    LiveMetrics metrics;
+    metrics.segment = NULL;
+    if (policy.metrics != NULL){
+        live_metrics_open(&metrics, filename);
+    }
+
+    while (1){
+        int quantum;
+        uint64_t now = ms_time(scheduler_start_time);
+        int job = policy.pick(state, now, &quantum);
+        if (job == -1){
+            // publish before going idle, a reader then sees the queues drained
+            if (metrics.segment != NULL){
+                publish_metrics(policy, state, &metrics, now);
+            }
+            if (policy.wait == NULL || !policy.wait(state)){
+                break;
+            }
+            continue;
+        }
+
+        Process *p = policy.process(state, job);
+        uint64_t burst_time = p->burst_time;
+        int res = 0;
+        if (quantum < 0){
+            run_process_completely(p, scheduler_start_time, &writer);
+        } else {
+            res = run_process_for_quantum(p, quantum, scheduler_start_time, &writer);
+        }
+        if (metrics.segment != NULL){
+            if (quantum >= 0){
+                live_metrics_slice(&metrics, quantum, p->burst_time - burst_time);
+            }
+            if (res <= 0){
+                live_metrics_complete(&metrics, p);
+            }
+        }
+        if (res > 0){
+            policy.requeue(state, job);
+        } else if (policy.complete != NULL){
+            policy.complete(state, job);
+        }
+        if (metrics.segment != NULL){
+            now = ms_time(scheduler_start_time);
+            if (now - metrics.last_publish >= LIVE_METRICS_INTERVAL_MS){
+                publish_metrics(policy, state, &metrics, now);
+            }
+        }
+    }
+
+    live_metrics_close(&metrics);
+    job_output_stop();
+    writer_stop(&writer);
+    fclose(file);
+}
+
+
+/*
+Multi-level feedback queue policy with up to MAX_QUEUE_LEVELS levels, shared by the offline and
+online schedulers: the front job of the highest non-empty level runs for the slice of its level,
+a job that uses up its slice moves one level down, and every boostTime all jobs move to level 0.
+With mlfq_tuning enabled the slices and boostTime follow the burst times of the completed jobs.
+*/
+typedef struct {
+    JobLinks links;
+    MultiLevelQueue queue;
+    int quantum[MAX_QUEUE_LEVELS];
+    uint64_t boost_time;
+    uint64_t last_boost_time;
+    int level;    // level of the job picked last
+    MlfqTuner tuner;
+} MlfqState;
+
+
+/* Whether the number of levels is from 1 to MAX_QUEUE_LEVELS, reports it otherwise */
+bool mlfq_levels_valid(int num_levels){
+    if (num_levels < 1 || num_levels > MAX_QUEUE_LEVELS){
+        fprintf(stderr, "MLFQ needs from 1 to %d levels, not %d\n", MAX_QUEUE_LEVELS, num_levels);
+        return false;
+    }
+    return true;
+}
+
+
+/*
+Initialise an empty multi-level feedback queue
+Input:
+    MlfqState *s: the state
+    int num_jobs: initial capacity of the links
+    int num_levels: number of levels, checked with mlfq_levels_valid
+    int quantum[]: time slice of each level
+    int boostTime: time after which all jobs are boosted to level 0
+*/
+void mlfq_init(MlfqState *s, int num_jobs, int num_levels, int quantum[], int boostTime){
+    job_links_init(&s->links, num_jobs);
+    mlq_init(&s->queue, num_levels);
+    for (int i=0; i<num_levels; i++){
+        s->quantum[i] = quantum[i];
+    }
+    s->boost_time = boostTime;
+    s->last_boost_time = 0;
+    s->level = 0;
+    memset(&s->tuner, 0, sizeof(s->tuner));
+}
+
+
+/* Queue a new job at the given level */
+void mlfq_add(MlfqState *s, int job, int level){
+    job_list_push_back(&s->links, &s->queue.level[level], job);
+}
+
+
+/* Next job and the slice of its level, -1 if every level is empty */
+int mlfq_pick(MlfqState *s, uint64_t now, int *quantum){
+    if (mlq_size(&s->queue) == 0){
+        return -1;
+    }
+    // boost all jobs to the highest priority level
+    if (now - s->last_boost_time >= s->boost_time){
+        mlq_boost(&s->links, &s->queue);
+        s->last_boost_time = now;
+    }
+    int job = mlq_pop_highest(&s->links, &s->queue, &s->level);
+    *quantum = s->quantum[s->level];
+    return job;
+}
+
+
+/* The job used up its time slice, move it to the next lower level if present */
+void mlfq_requeue(MlfqState *s, int job){
+    mlq_demote(&s->links, &s->queue, job, s->level);
+}
+
+
+/* The job finished or errored, its burst time feeds the adaptive tuning */
+void mlfq_complete(MlfqState *s, Process *p){
+    if (mlfq_tuning.enabled && !p->error){
+        mlfq_tuner_record(&s->tuner, s->queue.num_levels, s->quantum, &s->boost_time, p->burst_time, p->completion_time);
+    }
+}
+
+
+/* Levels, queue depths, slices and boost period of a live snapshot */
+void mlfq_metrics(MlfqState *s, LiveSnapshot *snapshot){
+    snapshot->num_levels = s->queue.num_levels;
+    for (int l=0; l<s->queue.num_levels; l++){
+        snapshot->level_depth[l] = s->queue.level[l].size;
+        snapshot->level_quantum[l] = s->quantum[l];
+    }
+    snapshot->boost_time = s->boost_time;
+    snapshot->pending = mlq_size(&s->queue);
+}
+
+
+void mlfq_free(MlfqState *s){
+    job_links_free(&s->links);
+}
+
+
+/*
+Completely fair policy shared by the offline and online schedulers: every job has a weight and a
+virtual runtime that grows by the time it ran scaled by CFS_DEFAULT_WEIGHT / weight, the runnable
+job with the smallest virtual runtime runs next. A period of target_latency is split between the
+runnable jobs in proportion to their weights, no slice being shorter than min_granularity, and the
+period stretches once the jobs would get less than that.
+*/
+typedef struct {
+    JobTree tree;    // runnable jobs other than the running one, keyed by virtual runtime
+    uint64_t *vruntime;    // in microseconds of a job of the default weight
+    int *weight;
+    int capacity;
+    uint64_t total_weight;    // of the runnable jobs, including the running one
+    int num_runnable;
+    uint64_t min_vruntime;    // smallest virtual runtime seen, new jobs start from it
+    uint64_t seq;
+    int target_latency;
+    int min_granularity;
+    uint64_t picked_burst_time;    // burst time of the job picked last, when it was picked
+} CfsState;
+
+
+void cfs_init(CfsState *s, int num_jobs, int target_latency, int min_granularity){
+    s->capacity = num_jobs > 0 ? num_jobs : 1;
+    job_tree_init(&s->tree, s->capacity);
+    s->vruntime = malloc(sizeof(uint64_t) * s->capacity);
+    s->weight = malloc(sizeof(int) * s->capacity);
+    s->total_weight = 0;
+    s->num_runnable = 0;
+    s->min_vruntime = 0;
+    s->seq = 0;
+    s->target_latency = target_latency;
+    s->min_granularity = min_granularity;
+    s->picked_burst_time = 0;
+}
+
+
+/* Grow the state so that jobs below capacity can be added */
+void cfs_reserve(CfsState *s, int capacity){
+    if (capacity <= s->capacity){
+        return;
+    }
+    job_tree_reserve(&s->tree, capacity);
+    s->capacity = s->tree.capacity;
+    s->vruntime = realloc(s->vruntime, sizeof(uint64_t) * s->capacity);
+    s->weight = realloc(s->weight, sizeof(int) * s->capacity);
+}
+
+
+/* Add a runnable job, it starts from the smallest virtual runtime so it cannot starve the others */
+void cfs_add(CfsState *s, int job, int weight){
+    s->weight[job] = weight > 0 ? weight : CFS_DEFAULT_WEIGHT;
+    s->vruntime[job] = s->min_vruntime;
+    s->total_weight += s->weight[job];
+    s->num_runnable++;
+    job_tree_insert(&s->tree, job, s->vruntime[job], s->seq++);
+}
+
+
+/*
+Next job and its slice
+Input:
+    CfsState *s: the state
+    Process procs[]: process records of the jobs
+    int *quantum: set to the slice of the job in milliseconds
+Output:
+    the job, -1 if none is runnable
+*/
+int cfs_pick(CfsState *s, Process procs[], int *quantum){
+    int job = job_tree_pop(&s->tree);
+    if (job == -1){
+        return -1;
+    }
+    if (s->vruntime[job] > s->min_vruntime){
+        s->min_vruntime = s->vruntime[job];
+    }
+    s->picked_burst_time = procs[job].burst_time;
+
+    uint64_t period = s->target_latency;
+    if ((uint64_t)s->num_runnable * s->min_granularity > period){
+        period = (uint64_t)s->num_runnable * s->min_granularity;
+    }
+    uint64_t slice = period * s->weight[job] / s->total_weight;
+    *quantum = slice > (uint64_t)s->min_granularity ? (int)slice : s->min_granularity;
+    return job;
+}
+
+
+/* The job used up its slice, charge the time it ran to its virtual runtime */
+void cfs_requeue(CfsState *s, Process procs[], int job){
+    uint64_t ran = procs[job].burst_time - s->picked_burst_time;
+    s->vruntime[job] += ran * 1000 * CFS_DEFAULT_WEIGHT / s->weight[job];
+    job_tree_insert(&s->tree, job, s->vruntime[job], s->seq++);
+}
+
+
+/* The job finished or errored */
+void cfs_complete(CfsState *s, int job){
+    s->total_weight -= s->weight[job];
+    s->num_runnable--;
+}
+
+
+void cfs_free(CfsState *s){
+    job_tree_free(&s->tree);
+    free(s->vruntime);
+    free(s->weight);
+}
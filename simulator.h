@@ -0,0 +1,419 @@
+#pragma once
+
+#include "utils.h"
+#include "run_queue.h"
+#include "history_index.h"
+#include "job_heap.h"
+#include "job_table.h"
+
+
+/*
+Discrete-event simulation of the schedulers on a virtual clock.
+Instead of forking and sleeping, every job has a known service time and the clock jumps from
+event to event: the next arrival or the end of the running slice, whichever comes first.
+The scheduling rules, result rows and context switch lines match the real schedulers.
+*/
+
+
+// virtual time every dispatch costs before the job runs, 0 for an ideal context switch
+static uint64_t sim_context_switch_cost = 0;
+
+
+/* A job of a simulated workload */
+typedef struct {
+    char *command;
+    uint64_t arrival_time;    // online schedulers expect jobs sorted by arrival time
+    uint64_t service_time;    // time the job needs to run until it exits
+    bool fails;    // the job exits with status 1 after its service time
+} SimJob;
+
+
+/* Aggregate counters of a simulated run */
+typedef struct {
+    uint64_t decisions;    // slices run, one per context switch line
+    uint64_t makespan;     // virtual time at which the last job completed
+    uint64_t busy_time;    // virtual time the cpu was running a job
+    PredictionStats prediction;    // burst time predictions of the online policies
+} SimStats;
+
+
+/* Reset the result record of every job before a run */
+void sim_init_results(SimJob jobs[], Process results[], int n, SimStats *stats){
+    for (int i=0; i<n; i++){
+        memset(&results[i], 0, sizeof(Process));
+        results[i].command = jobs[i].command;
+        results[i].arrival_time = jobs[i].arrival_time;
+        results[i].process_id = -1;
+        results[i].pidfd = -1;
+    }
+    memset(stats, 0, sizeof(SimStats));
+}
+
+
+/*
+Run a job for the given slice of virtual time, or less if it completes within the slice, after
+the dispatch cost sim_context_switch_cost
+Input:
+    SimJob *job: the job
+    Process *r: its result record
+    uint64_t *now: virtual clock, advanced by the time the job ran
+    uint64_t slice: maximum time to run
+    FILE *file: result csv, NULL to skip the rows
+    FILE *trace: destination of the context switch lines, NULL to skip them
+    SimStats *stats: counters of the run
+Output:
+    0 if the job completed during the slice, 1 if it used up the entire slice
+*/
+int sim_run_slice(SimJob *job, Process *r, uint64_t *now, uint64_t slice, FILE *file, FILE *trace, SimStats *stats){
+    *now += sim_context_switch_cost;
+    if (!r->started){
+        r->started = true;
+        r->start_time = *now;
+        r->response_time = r->start_time - r->arrival_time;
+    }
+    uint64_t remaining = job->service_time - r->burst_time;
+    uint64_t ran = slice < remaining ? slice : remaining;
+    uint64_t context_start_time = *now;
+    *now += ran;
+    r->burst_time += ran;
+    r->cpu_time = r->burst_time;    // simulated jobs never block
+    stats->busy_time += ran;
+    stats->decisions++;
+
+    int ret = 1;
+    if (r->burst_time >= job->service_time){
+        r->error = job->fails;
+        r->finished = !job->fails;
+        r->completion_time = *now;
+        r->turnaround_time = r->completion_time - r->arrival_time;
+        r->waiting_time = r->turnaround_time - r->burst_time;
+        if (file != NULL){
+            print_result(file, r);
+        }
+        stats->makespan = *now;
+        ret = 0;
+    }
+    if (trace != NULL){
+        context_switch_output_to(trace, r, context_start_time, *now);
+    }
+    return ret;
+}
+
+
+/* Reset the results and fill the job table of an offline run */
+void sim_init_table(SimJob jobs[], Process results[], int n, JobTable *t, SimStats *stats){
+    sim_init_results(jobs, results, n, stats);
+    job_table_init(t, n);
+    for (int i=0; i<n; i++){
+        t->active[i].remaining = jobs[i].service_time;
+    }
+}
+
+
+/*
+sim_run_slice on the job table of an offline run: the slice only reads and writes the hot entry of
+the job, its SimJob and result record are touched when it starts and completes, and for the context
+switch line if there is a trace
+Input:
+    ActiveJob *a: entry of the job in the job table
+    SimJob jobs[], Process results[]: workload and result records
+    the other inputs and the output are those of sim_run_slice
+*/
+int sim_table_run_slice(ActiveJob *a, SimJob jobs[], Process results[], uint64_t *now, uint64_t slice, FILE *file, FILE *trace, SimStats *stats){
+    int job = a->job;
+    *now += sim_context_switch_cost;
+    if (!a->started){
+        a->started = 1;
+        Process *r = &results[job];
+        r->started = true;
+        r->start_time = *now;
+        r->response_time = r->start_time - r->arrival_time;
+    }
+    uint64_t remaining = a->remaining;
+    uint64_t ran = slice < remaining ? slice : remaining;
+    uint64_t context_start_time = *now;
+    *now += ran;
+    a->remaining = remaining - ran;
+    stats->busy_time += ran;
+    stats->decisions++;
+
+    int ret = 1;
+    if (ran == remaining){
+        Process *r = &results[job];
+        r->burst_time = jobs[job].service_time;
+        r->cpu_time = r->burst_time;
+        r->error = jobs[job].fails;
+        r->finished = !jobs[job].fails;
+        r->completion_time = *now;
+        r->turnaround_time = r->completion_time - r->arrival_time;
+        r->waiting_time = r->turnaround_time - r->burst_time;
+        if (file != NULL){
+            print_result(file, r);
+        }
+        stats->makespan = *now;
+        ret = 0;
+    }
+    if (trace != NULL){
+        context_switch_output_to(trace, &results[job], context_start_time, *now);
+    }
+    return ret;
+}
+
+
+/*
+Simulated First Come First Serve Scheduling
+Input:
+    SimJob jobs[]: workload
+    Process results[]: filled with the metrics of every job
+    int n: number of jobs
+    FILE *file: result csv, NULL to skip it
+    FILE *trace: destination of the context switch lines, NULL to skip them
+Output: counters of the run
+*/
+SimStats SimFCFS(SimJob jobs[], Process results[], int n, FILE *file, FILE *trace){
+    SimStats stats;
+    JobTable table;
+    sim_init_table(jobs, results, n, &table, &stats);
+    uint64_t now = 0;
+    for (int i=0; i<n; i++){
+        sim_table_run_slice(&table.active[i], jobs, results, &now, UINT64_MAX, file, trace, &stats);
+    }
+    job_table_free(&table);
+    return stats;
+}
+
+
+/*
+Simulated Round Robin Scheduling
+Every job is queued at time 0, so a round is a pass over the active jobs in order: the jobs that
+used up their slice are compacted in place at the front of the active array and make the next round.
+Input:
+    SimJob jobs[]: workload
+    Process results[]: filled with the metrics of every job
+    int n: number of jobs
+    int quantum: time slice in milliseconds
+    FILE *file: result csv, NULL to skip it
+    FILE *trace: destination of the context switch lines, NULL to skip them
+Output: counters of the run
+*/
+SimStats SimRoundRobin(SimJob jobs[], Process results[], int n, int quantum, FILE *file, FILE *trace){
+    SimStats stats;
+    JobTable table;
+    sim_init_table(jobs, results, n, &table, &stats);
+
+    uint64_t now = 0;
+    while (table.num_active > 0){
+        int kept = 0;
+        for (int i=0; i<table.num_active; i++){
+            if (sim_table_run_slice(&table.active[i], jobs, results, &now, quantum, file, trace, &stats) > 0){
+                table.active[kept++] = table.active[i];
+            }
+        }
+        table.num_active = kept;
+    }
+
+    job_table_free(&table);
+    return stats;
+}
+
+
+/*
+Simulated Multi-Level Feedback Queue Scheduling with 3 queues, as the offline scheduler
+Input:
+    SimJob jobs[]: workload
+    Process results[]: filled with the metrics of every job
+    int n: number of jobs
+    int quantum0, quantum1, quantum2: time slice of each queue
+    int boostTime: time after which all jobs are boosted to the highest priority queue
+    FILE *file: result csv, NULL to skip it
+    FILE *trace: destination of the context switch lines, NULL to skip them
+Output: counters of the run
+*/
+SimStats SimMultiLevelFeedbackQueue(SimJob jobs[], Process results[], int n, int quantum0, int quantum1, int quantum2, int boostTime, FILE *file, FILE *trace){
+    SimStats stats;
+    JobTable table;
+    sim_init_table(jobs, results, n, &table, &stats);
+    JobLinks links;
+    job_links_init(&links, n);
+    MultiLevelQueue queue;
+    mlq_init(&queue, 3);
+    for (int i=0; i<n; i++){
+        job_list_push_back(&links, &queue.level[0], i);
+    }
+    int quantum[3] = {quantum0, quantum1, quantum2};
+
+    uint64_t now = 0;
+    uint64_t last_boost_time = 0;
+    int level;
+    while (1){
+        if (now - last_boost_time >= (uint64_t)boostTime){
+            mlq_boost(&links, &queue);
+            last_boost_time = now;
+        }
+        int job = mlq_pop_highest(&links, &queue, &level);
+        if (job == -1){
+            break;
+        }
+        if (sim_table_run_slice(&table.active[job], jobs, results, &now, quantum[level], file, trace, &stats) > 0){
+            mlq_demote(&links, &queue, job, level);
+        }
+    }
+
+    job_links_free(&links);
+    job_table_free(&table);
+    return stats;
+}
+
+
+/*
+Simulated online Shortest Job First Scheduling: jobs arrive over time and the pending job whose
+command has the least predicted burst time runs to completion.
+Pending jobs of a command all share its predicted burst time, so the heap holds commands keyed by
+(predicted burst time, arrival of their oldest pending job) and each command queues its jobs in order.
+A history update then re-keys one heap entry, however many jobs of the command are pending.
+Input:
+    SimJob jobs[]: workload sorted by arrival time
+    Process results[]: filled with the metrics of every job
+    int n: number of jobs
+    FILE *file: result csv, NULL to skip it
+    FILE *trace: destination of the context switch lines, NULL to skip them
+Output: counters of the run
+*/
+SimStats SimShortestJobFirst(SimJob jobs[], Process results[], int n, FILE *file, FILE *trace){
+    SimStats stats;
+    sim_init_results(jobs, results, n, &stats);
+    HistoryIndex histories;
+    history_index_init(&histories, 0, &burst_predictor);
+    JobHeap heap;
+    job_heap_init(&heap, histories.capacity);
+    JobLinks links;
+    job_links_init(&links, n);
+    int pending_capacity = histories.capacity;
+    JobList *pending = malloc(sizeof(JobList) * pending_capacity);
+    int num_pending = 0;
+
+    uint64_t now = 0;
+    int next_arrival = 0;
+    while (next_arrival < n || num_pending > 0){
+        // an idle cpu jumps to the next arrival
+        if (num_pending == 0 && jobs[next_arrival].arrival_time > now){
+            now = jobs[next_arrival].arrival_time;
+        }
+        while (next_arrival < n && jobs[next_arrival].arrival_time <= now){
+            int job = next_arrival++;
+            bool created;
+            int history_idx = history_index_intern(&histories, jobs[job].command, &created);
+            if (histories.capacity > pending_capacity){
+                pending = realloc(pending, sizeof(JobList) * histories.capacity);
+                pending_capacity = histories.capacity;
+                job_heap_reserve(&heap, pending_capacity);
+            }
+            if (created){
+                job_list_init(&pending[history_idx]);
+            }
+            results[job].history_idx = history_idx;
+            if (pending[history_idx].size == 0){
+                job_heap_push(&heap, history_idx, history_at(&histories, history_idx)->predicted_burst_time, job);
+            }
+            job_list_push_back(&links, &pending[history_idx], job);
+            num_pending++;
+        }
+
+        int history_idx = job_heap_pop(&heap);
+        int job = job_list_pop_front(&links, &pending[history_idx]);
+        num_pending--;
+        sim_run_slice(&jobs[job], &results[job], &now, UINT64_MAX, file, trace, &stats);
+
+        // update the predicted burst time of the command, its next pending job takes its place in the heap
+        if (!results[job].error){
+            history_record_burst(&histories, history_idx, results[job].burst_time);
+        }
+        ProcessHistory *cph = history_at(&histories, history_idx);
+        if (pending[history_idx].size > 0){
+            job_heap_push(&heap, history_idx, cph->predicted_burst_time, pending[history_idx].head);
+        }
+    }
+
+    stats.prediction = histories.stats;
+    history_index_free(&histories);
+    job_heap_free(&heap);
+    job_links_free(&links);
+    free(pending);
+    return stats;
+}
+
+
+/*
+Simulated online Multi-Level Feedback Queue Scheduling: arrivals are placed in a queue according to
+the predicted burst time of their command, as the online scheduler
+Input:
+    SimJob jobs[]: workload sorted by arrival time
+    Process results[]: filled with the metrics of every job
+    int n: number of jobs
+    int quantum0, quantum1, quantum2: time slice of each queue
+    int boostTime: time after which all jobs are boosted to the highest priority queue
+    FILE *file: result csv, NULL to skip it
+    FILE *trace: destination of the context switch lines, NULL to skip them
+Output: counters of the run
+*/
+SimStats SimOnlineMultiLevelFeedbackQueue(SimJob jobs[], Process results[], int n, int quantum0, int quantum1, int quantum2, int boostTime, FILE *file, FILE *trace){
+    SimStats stats;
+    sim_init_results(jobs, results, n, &stats);
+    HistoryIndex histories;
+    history_index_init(&histories, 0, &burst_predictor);
+    JobLinks links;
+    job_links_init(&links, n);
+    MultiLevelQueue queue;
+    mlq_init(&queue, 3);
+    int quantum[3] = {quantum0, quantum1, quantum2};
+
+    uint64_t now = 0;
+    uint64_t last_boost_time = 0;
+    int next_arrival = 0;
+    int num_queued = 0;
+    while (next_arrival < n || num_queued > 0){
+        if (num_queued == 0 && jobs[next_arrival].arrival_time > now){
+            now = jobs[next_arrival].arrival_time;
+        }
+        while (next_arrival < n && jobs[next_arrival].arrival_time <= now){
+            int job = next_arrival++;
+            bool created;
+            int queue_idx = 1;
+            int history_idx = history_index_intern(&histories, jobs[job].command, &created);
+            results[job].history_idx = history_idx;
+            if (!created){
+                uint64_t predicted_burst_time = history_at(&histories, history_idx)->predicted_burst_time;
+                if (predicted_burst_time < (uint64_t)quantum[0]){
+                    queue_idx = 0;
+                } else if (predicted_burst_time < (uint64_t)quantum[1]){
+                    queue_idx = 1;
+                } else {
+                    queue_idx = 2;
+                }
+            }
+            job_list_push_back(&links, &queue.level[queue_idx], job);
+            num_queued++;
+        }
+
+        if (now - last_boost_time >= (uint64_t)boostTime){
+            mlq_boost(&links, &queue);
+            last_boost_time = now;
+        }
+
+        int level;
+        int job = mlq_pop_highest(&links, &queue, &level);
+        if (sim_run_slice(&jobs[job], &results[job], &now, quantum[level], file, trace, &stats) > 0){
+            mlq_demote(&links, &queue, job, level);
+        } else {
+            num_queued--;
+            if (!results[job].error){
+                history_record_burst(&histories, results[job].history_idx, results[job].burst_time);
+            }
+        }
+    }
+
+    stats.prediction = histories.stats;
+    history_index_free(&histories);
+    job_links_free(&links);
+    return stats;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define SLAB_MIN_BLOCK 64
+#define SLAB_NUM_CLASSES 5    // blocks of 64, 128, 256, 512 and 1024 bytes
+#define SLAB_CHUNK_BLOCKS 64
+#define SLAB_HEADER 16    // keeps the alignment malloc gives
+#define SLAB_LARGE 0xff
+
+
+/*
+Size-class slab allocator for the short-lived per-job allocations of the schedulers: arrivals,
+tokenized argv and the command strings of the histories.
+Freed blocks go back to the free list of their class and are handed out again, the memory of a class
+is never returned to malloc, so a long-running scheduler stays at the footprint of its peak number
+of pending jobs instead of depending on how malloc copes with blocks allocated on the intake thread
+and freed on the scheduler thread. Blocks larger than the largest class come from malloc.
+Every block is preceded by a header holding its class.
+*/
+typedef struct SlabBlock {
+    struct SlabBlock *next;
+} SlabBlock;
+
+
+typedef struct {
+    pthread_mutex_t lock;
+    SlabBlock *free;
+    uint64_t num_blocks;    // blocks carved so far, free or in use
+} SlabClass;
+
+
+static SlabClass slab_classes[SLAB_NUM_CLASSES] = {
+    {.lock = PTHREAD_MUTEX_INITIALIZER}, {.lock = PTHREAD_MUTEX_INITIALIZER}, {.lock = PTHREAD_MUTEX_INITIALIZER},
+    {.lock = PTHREAD_MUTEX_INITIALIZER}, {.lock = PTHREAD_MUTEX_INITIALIZER}
+};
+
+
+/* Allocate a block of at least size bytes, from the slab if a class is large enough */
+void *slab_alloc(size_t size){
+    size_t total = size + SLAB_HEADER;
+    int c = 0;
+    while (c < SLAB_NUM_CLASSES && ((size_t)SLAB_MIN_BLOCK << c) < total){
+        c++;
+    }
+    unsigned char *block;
+    if (c == SLAB_NUM_CLASSES){
+        block = malloc(total);
+        block[0] = SLAB_LARGE;
+        return block + SLAB_HEADER;
+    }
+
+    SlabClass *sc = &slab_classes[c];
+    pthread_mutex_lock(&sc->lock);
+    if (sc->free == NULL){
+        // carve a new chunk into blocks
+        size_t block_size = (size_t)SLAB_MIN_BLOCK << c;
+        unsigned char *chunk = malloc(block_size * SLAB_CHUNK_BLOCKS);
+        for (int i=SLAB_CHUNK_BLOCKS-1; i>=0; i--){
+            SlabBlock *b = (SlabBlock *)(chunk + i * block_size);
+            b->next = sc->free;
+            sc->free = b;
+        }
+        sc->num_blocks += SLAB_CHUNK_BLOCKS;
+    }
+    block = (unsigned char *)sc->free;
+    sc->free = sc->free->next;
+    pthread_mutex_unlock(&sc->lock);
+
+    block[0] = c;
+    return block + SLAB_HEADER;
+}
+
+
+/* Return a block from slab_alloc, NULL is ignored */
+void slab_free(void *ptr){
+    if (ptr == NULL){
+        return;
+    }
+    unsigned char *block = (unsigned char *)ptr - SLAB_HEADER;
+    if (block[0] == SLAB_LARGE){
+        free(block);
+        return;
+    }
+    SlabClass *sc = &slab_classes[block[0]];
+    SlabBlock *b = (SlabBlock *)block;
+    pthread_mutex_lock(&sc->lock);
+    b->next = sc->free;
+    sc->free = b;
+    pthread_mutex_unlock(&sc->lock);
+}
+
+
+char *slab_strdup(const char *s){
+    size_t len = strlen(s);
+    char *copy = slab_alloc(len + 1);
+    memcpy(copy, s, len + 1);
+    return copy;
+}
+
+
+/* Bytes held by the slab classes, free or in use */
+uint64_t slab_footprint(){
+    uint64_t bytes = 0;
+    for (int c=0; c<SLAB_NUM_CLASSES; c++){
+        pthread_mutex_lock(&slab_classes[c].lock);
+        bytes += slab_classes[c].num_blocks * ((uint64_t)SLAB_MIN_BLOCK << c);
+        pthread_mutex_unlock(&slab_classes[c].lock);
+    }
+    return bytes;
+}
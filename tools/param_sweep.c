@@ -0,0 +1,308 @@
+/*
+Parameter sweep of the offline Round Robin and MLFQ schedulers on the simulator.
+Every combination of the given time slices and boost times is run on the same workload, in parallel
+on a pool of threads since a simulated run owns its clock, queues and output files. Each
+configuration writes its result csv to its own file in the output directory, and the sweep ends with
+a summary of every configuration marking the ones on the Pareto front of throughput against p99
+response time: no other configuration has both a higher throughput and a lower p99.
+Dispatches cost --switch-cost ms of virtual time, which is what makes short slices lose throughput.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. tools/param_sweep.c -o param_sweep -lm
+    ./param_sweep --dist heavy-tailed --jobs 100000 --rr 5:100:5 --q0 5,10,20 --q1 20,40 --q2 80,160 --boost 500,2000
+Options:
+    --dist exponential|bimodal|heavy-tailed|replay:<file>
+    --jobs N --mean MS --long MS --long-fraction F --alpha A --seed S
+                            workload, as in bench/sched_bench.c, every job arrives at time 0
+    --rr LIST               Round Robin time slices
+    --q0 LIST --q1 LIST --q2 LIST --boost LIST
+                            MLFQ time slices and boost times, combinations with q0 <= q1 <= q2
+    --switch-cost MS        virtual cost of a dispatch (1)
+    --threads N             worker threads (number of online cpus)
+    --out-dir DIR           directory of the result csvs and sweep_summary.csv (sweep)
+    --switches              also write the context switch lines of every configuration
+A LIST is comma separated values or a range START:END:STEP, all positive. At most 1048576
+configurations are run.
+*/
+#include "simulator.h"
+#include "bench/workload.h"
+#include "bench/bench_report.h"
+#include <getopt.h>
+#include <sys/stat.h>
+
+#define MAX_SWEEP_VALUES 1024
+#define MAX_SWEEP_CONFIGS (1 << 20)    // largest grid of configurations that is run
+
+
+typedef struct {
+    int values[MAX_SWEEP_VALUES];
+    int n;
+} SweepList;
+
+
+/* A configuration to run and, once run, its metrics */
+typedef struct {
+    bool mlfq;
+    int quantum[3];    // RR uses quantum[0]
+    int boost_time;
+    char name[64];
+    uint64_t decisions;
+    double throughput;    // jobs per second of virtual time
+    double mean_response;
+    double p99_response;
+    bool pareto;
+} SweepConfig;
+
+
+typedef struct {
+    SimJob *jobs;
+    int n;
+    SweepConfig *configs;
+    int num_configs;
+    int next;    // next configuration to run, taken atomically by the workers
+    const char *out_dir;
+    bool switches;
+} Sweep;
+
+
+/* Parse "a,b,c" or "start:end:step" of positive values, false on a malformed list */
+bool parse_sweep_list(const char *arg, SweepList *list){
+    int start, end, step;
+    list->n = 0;
+    if (sscanf(arg, "%d:%d:%d", &start, &end, &step) == 3){
+        if (step <= 0 || start <= 0){
+            return false;
+        }
+        for (long v=start; v<=end && list->n<MAX_SWEEP_VALUES; v+=step){
+            list->values[list->n++] = v;
+        }
+        return list->n > 0;
+    }
+    const char *s = arg;
+    while (*s != '\0' && list->n < MAX_SWEEP_VALUES){
+        char *end_ptr;
+        long v = strtol(s, &end_ptr, 10);
+        if (end_ptr == s || v <= 0){
+            return false;
+        }
+        list->values[list->n++] = v;
+        s = *end_ptr == ',' ? end_ptr + 1 : end_ptr;
+        if (*end_ptr != ',' && *end_ptr != '\0'){
+            return false;
+        }
+    }
+    return list->n > 0;
+}
+
+
+/* Every RR slice and every ordered MLFQ combination of the lists, -1 if the grid exceeds MAX_SWEEP_CONFIGS */
+int build_configs(SweepList *rr, SweepList *q0, SweepList *q1, SweepList *q2, SweepList *boost, SweepConfig **configs){
+    size_t capacity = (size_t)rr->n + (size_t)q0->n * q1->n * q2->n * boost->n;
+    if (capacity > MAX_SWEEP_CONFIGS){
+        return -1;
+    }
+    *configs = calloc(capacity > 0 ? capacity : 1, sizeof(SweepConfig));
+    int n = 0;
+    for (int i=0; i<rr->n; i++){
+        SweepConfig *c = &(*configs)[n++];
+        c->quantum[0] = rr->values[i];
+        snprintf(c->name, sizeof(c->name), "RR_%d", c->quantum[0]);
+    }
+    for (int a=0; a<q0->n; a++){
+        for (int b=0; b<q1->n; b++){
+            for (int d=0; d<q2->n; d++){
+                for (int e=0; e<boost->n; e++){
+                    if (q0->values[a] > q1->values[b] || q1->values[b] > q2->values[d]){
+                        continue;
+                    }
+                    SweepConfig *c = &(*configs)[n++];
+                    c->mlfq = true;
+                    c->quantum[0] = q0->values[a];
+                    c->quantum[1] = q1->values[b];
+                    c->quantum[2] = q2->values[d];
+                    c->boost_time = boost->values[e];
+                    snprintf(c->name, sizeof(c->name), "MLFQ_%d_%d_%d_%d", c->quantum[0], c->quantum[1], c->quantum[2], c->boost_time);
+                }
+            }
+        }
+    }
+    return n;
+}
+
+
+FILE *open_sweep_file(const char *dir, const char *name, const char *suffix){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/result_offline_%s%s", dir, name, suffix);
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        perror(path);
+    }
+    return file;
+}
+
+
+/* Worker thread: run configurations until none is left */
+void *sweep_worker(void *arg){
+    Sweep *sw = arg;
+    Process *results = malloc(sizeof(Process) * sw->n);
+    uint64_t *values = malloc(sizeof(uint64_t) * sw->n);
+    int i;
+    while ((i = __atomic_fetch_add(&sw->next, 1, __ATOMIC_RELAXED)) < sw->num_configs){
+        SweepConfig *c = &sw->configs[i];
+        FILE *file = open_sweep_file(sw->out_dir, c->name, ".csv");
+        FILE *trace = sw->switches ? open_sweep_file(sw->out_dir, c->name, "_switches.txt") : NULL;
+        if (file != NULL){
+            fprintf(file, RESULT_CSV_HEADER);
+        }
+
+        SimStats stats = c->mlfq
+            ? SimMultiLevelFeedbackQueue(sw->jobs, results, sw->n, c->quantum[0], c->quantum[1], c->quantum[2], c->boost_time, file, trace)
+            : SimRoundRobin(sw->jobs, results, sw->n, c->quantum[0], file, trace);
+        if (file != NULL) fclose(file);
+        if (trace != NULL) fclose(trace);
+
+        double p50;
+        for (int j=0; j<sw->n; j++){
+            values[j] = results[j].response_time;
+        }
+        summarize(values, sw->n, &c->mean_response, &p50, &c->p99_response);
+        c->decisions = stats.decisions;
+        c->throughput = stats.makespan > 0 ? sw->n / (stats.makespan / 1000.0) : 0;
+    }
+    free(values);
+    free(results);
+    return NULL;
+}
+
+
+/* Mark the configurations no other one beats on both throughput and p99 response time */
+void mark_pareto_front(SweepConfig configs[], int n){
+    for (int i=0; i<n; i++){
+        configs[i].pareto = true;
+        for (int j=0; j<n && configs[i].pareto; j++){
+            bool no_worse = configs[j].throughput >= configs[i].throughput && configs[j].p99_response <= configs[i].p99_response;
+            bool better = configs[j].throughput > configs[i].throughput || configs[j].p99_response < configs[i].p99_response;
+            if (no_worse && better){
+                configs[i].pareto = false;
+            }
+        }
+    }
+}
+
+
+int compare_configs_by_throughput(const void *a, const void *b){
+    const SweepConfig *x = a;
+    const SweepConfig *y = b;
+    return (x->throughput < y->throughput) - (x->throughput > y->throughput);
+}
+
+
+int main(int argc, char **argv){
+    WorkloadConfig workload = default_workload();
+    workload.load = 0;
+    SweepList rr = {.n = 0}, q0 = {.n = 0}, q1 = {.n = 0}, q2 = {.n = 0}, boost = {.n = 0};
+    const char *out_dir = "sweep";
+    bool switches = false;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    sim_context_switch_cost = 1;
+
+    struct option options[] = {
+        {"dist", required_argument, 0, 'd'}, {"jobs", required_argument, 0, 'n'},
+        {"mean", required_argument, 0, 'u'}, {"long", required_argument, 0, 'L'},
+        {"long-fraction", required_argument, 0, 'f'}, {"alpha", required_argument, 0, 'a'},
+        {"seed", required_argument, 0, 's'}, {"rr", required_argument, 0, 'r'},
+        {"q0", required_argument, 0, '0'}, {"q1", required_argument, 0, '1'},
+        {"q2", required_argument, 0, '2'}, {"boost", required_argument, 0, 'b'},
+        {"switch-cost", required_argument, 0, 'c'}, {"threads", required_argument, 0, 't'},
+        {"out-dir", required_argument, 0, 'o'}, {"switches", no_argument, 0, 'w'},
+        {0, 0, 0, 0}
+    };
+    bool ok = true;
+    int c;
+    while (ok && (c = getopt_long(argc, argv, "", options, NULL)) != -1){
+        switch (c){
+        case 'd': ok = parse_distribution(optarg, &workload); break;
+        case 'n': workload.num_jobs = atoi(optarg); break;
+        case 'u': workload.mean_burst = atof(optarg); break;
+        case 'L': workload.long_burst = atof(optarg); break;
+        case 'f': workload.long_fraction = atof(optarg); break;
+        case 'a': workload.pareto_alpha = atof(optarg); break;
+        case 's': workload.seed = strtoull(optarg, NULL, 10); break;
+        case 'r': ok = parse_sweep_list(optarg, &rr); break;
+        case '0': ok = parse_sweep_list(optarg, &q0); break;
+        case '1': ok = parse_sweep_list(optarg, &q1); break;
+        case '2': ok = parse_sweep_list(optarg, &q2); break;
+        case 'b': ok = parse_sweep_list(optarg, &boost); break;
+        case 'c': sim_context_switch_cost = strtoull(optarg, NULL, 10); break;
+        case 't': threads = atoi(optarg); break;
+        case 'o': out_dir = optarg; break;
+        case 'w': switches = true; break;
+        default: ok = false;
+        }
+    }
+    if (!ok){
+        fprintf(stderr, "usage: see the header of tools/param_sweep.c\n");
+        return 1;
+    }
+
+    Sweep sw = {.out_dir = out_dir, .switches = switches, .next = 0};
+    sw.num_configs = build_configs(&rr, &q0, &q1, &q2, &boost, &sw.configs);
+    if (sw.num_configs < 0){
+        fprintf(stderr, "too many configurations, the lists give more than %d\n", MAX_SWEEP_CONFIGS);
+        return 1;
+    }
+    if (sw.num_configs == 0){
+        fprintf(stderr, "nothing to sweep, give --rr or all of --q0 --q1 --q2 --boost\n");
+        return 1;
+    }
+    if (mkdir(out_dir, 0755) < 0 && errno != EEXIST){
+        perror(out_dir);
+        return 1;
+    }
+    sw.n = generate_workload(&workload, &sw.jobs);
+    // the offline schedulers assume every job is there at time 0
+    for (int i=0; i<sw.n; i++){
+        sw.jobs[i].arrival_time = 0;
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > sw.num_configs) threads = sw.num_configs;
+    double start = wall_seconds();
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    for (int t=0; t<threads; t++){
+        pthread_create(&workers[t], NULL, sweep_worker, &sw);
+    }
+    for (int t=0; t<threads; t++){
+        pthread_join(workers[t], NULL);
+    }
+    free(workers);
+    double elapsed = wall_seconds() - start;
+
+    mark_pareto_front(sw.configs, sw.num_configs);
+    qsort(sw.configs, sw.num_configs, sizeof(SweepConfig), compare_configs_by_throughput);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/sweep_summary.csv", out_dir);
+    FILE *summary = fopen(path, "w");
+    if (summary == NULL){
+        perror(path);
+        return 1;
+    }
+    fprintf(summary, "Configuration,Scheduler,Quantum0,Quantum1,Quantum2,Boost Time,Decisions,Throughput,Mean Response,P99 Response,Pareto\n");
+    printf("%d configurations of %d jobs on %d threads in %.2f s, Pareto front of throughput and p99 response:\n",
+        sw.num_configs, sw.n, threads, elapsed);
+    for (int i=0; i<sw.num_configs; i++){
+        SweepConfig *cfg = &sw.configs[i];
+        fprintf(summary, "%s,%s,%d,%d,%d,%d,%lu,%.3f,%.1f,%.1f,%s\n",
+            cfg->name, cfg->mlfq ? "MLFQ" : "RR", cfg->quantum[0], cfg->quantum[1], cfg->quantum[2], cfg->boost_time,
+            cfg->decisions, cfg->throughput, cfg->mean_response, cfg->p99_response, cfg->pareto ? "Yes" : "No");
+        if (cfg->pareto){
+            printf("    %-28s %10.3f jobs/s   p99 response %10.1f ms   mean response %10.1f ms\n",
+                cfg->name, cfg->throughput, cfg->p99_response, cfg->mean_response);
+        }
+    }
+    fclose(summary);
+    printf("results in %s, summary in %s\n", out_dir, path);
+
+    free(sw.configs);
+    return 0;
+}
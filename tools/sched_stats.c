@@ -0,0 +1,91 @@
+/*
+Query the live metrics of a running scheduler (set live_metrics_name, and live_metrics_socket for
+--socket, before starting one).
+With --socket the scheduler's server thread formats the snapshot; with --shm the segment is mapped
+read-only and read under its seqlock, which never disturbs the scheduling loop.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. tools/sched_stats.c -o sched_stats
+    ./sched_stats --socket PATH | --shm NAME [--watch MS]
+With --watch the metrics are printed again every MS milliseconds until interrupted.
+*/
+#include "live_metrics.h"
+
+
+/* Print the reply of the scheduler on the socket, false if it is not listening */
+bool query_socket(const char *path){
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        perror(path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    char buf[LIVE_METRICS_TEXT_SIZE];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0){
+        fwrite(buf, 1, len, stdout);
+    }
+    close(fd);
+    return true;
+}
+
+
+/* Map the segment of the scheduler read-only, NULL if it does not exist */
+LiveSegment *map_segment(const char *name){
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0){
+        perror(name);
+        return NULL;
+    }
+    LiveSegment *segment = mmap(NULL, sizeof(LiveSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED){
+        perror(name);
+        return NULL;
+    }
+    return segment;
+}
+
+
+int main(int argc, char **argv){
+    const char *socket_path = NULL;
+    const char *shm_name = NULL;
+    int watch = 0;
+    for (int i=1; i+1<argc; i+=2){
+        if (strcmp(argv[i], "--socket") == 0){
+            socket_path = argv[i+1];
+        } else if (strcmp(argv[i], "--shm") == 0){
+            shm_name = argv[i+1];
+        } else if (strcmp(argv[i], "--watch") == 0){
+            watch = atoi(argv[i+1]);
+        }
+    }
+    if ((socket_path == NULL) == (shm_name == NULL)){
+        fprintf(stderr, "usage: %s --socket PATH | --shm NAME [--watch MS]\n", argv[0]);
+        return 1;
+    }
+
+    LiveSegment *segment = NULL;
+    if (shm_name != NULL && (segment = map_segment(shm_name)) == NULL){
+        return 1;
+    }
+    char text[LIVE_METRICS_TEXT_SIZE];
+    while (1){
+        if (segment != NULL){
+            LiveSnapshot snapshot;
+            live_metrics_read(segment, &snapshot);
+            int len = live_metrics_format(&snapshot, text, sizeof(text));
+            fwrite(text, 1, len, stdout);
+        } else if (!query_socket(socket_path)){
+            return 1;
+        }
+        if (watch <= 0){
+            break;
+        }
+        printf("\n");
+        fflush(stdout);
+        usleep(watch * 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+Replay a binary trace recorded by the schedulers (set trace_record_path before starting one).
+Rebuilds the result csv and the context switch lines of the run, and turns the recorded jobs into
+a workload of "arrival,burst,command" lines that bench/sched_bench.c reads with --dist replay:<file>.
+Build and run from the repository root:
+    gcc -O2 -pthread -I. tools/trace_replay.c -o trace_replay
+    ./trace_replay TRACE [--csv FILE] [--switches FILE] [--workload FILE]
+Without an option the result csv is written to stdout.
+*/
+#include "utils.h"
+
+
+typedef struct {
+    uint64_t arrival_time;
+    uint64_t burst_time;
+    uint32_t job;
+    uint32_t command_id;
+} ReplayJob;
+
+
+int compare_replay_jobs(const void *a, const void *b){
+    const ReplayJob *x = a;
+    const ReplayJob *y = b;
+    if (x->arrival_time != y->arrival_time){
+        return (x->arrival_time > y->arrival_time) - (x->arrival_time < y->arrival_time);
+    }
+    return (x->job > y->job) - (x->job < y->job);
+}
+
+
+FILE *open_output(const char *path){
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        perror(path);
+        exit(1);
+    }
+    return file;
+}
+
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        fprintf(stderr, "usage: %s TRACE [--csv FILE] [--switches FILE] [--workload FILE]\n", argv[0]);
+        return 1;
+    }
+    TraceReader t;
+    if (!trace_open(&t, argv[1])){
+        fprintf(stderr, "%s: not a valid trace of this version\n", argv[1]);
+        return 1;
+    }
+    FILE *csv = NULL, *switches = NULL, *workload = NULL;
+    for (int i=2; i+1<argc; i+=2){
+        if (strcmp(argv[i], "--csv") == 0){
+            csv = open_output(argv[i+1]);
+        } else if (strcmp(argv[i], "--switches") == 0){
+            switches = open_output(argv[i+1]);
+        } else if (strcmp(argv[i], "--workload") == 0){
+            workload = open_output(argv[i+1]);
+        }
+    }
+    if (csv == NULL && switches == NULL && workload == NULL){
+        csv = stdout;
+    }
+
+    // first pass: the command of every job, its ARRIVAL event comes after its slices
+    uint64_t num_events = t.header->num_events;
+    uint32_t num_jobs = 0;
+    for (uint64_t i=0; i<num_events; i++){
+        if (t.events[i].job >= num_jobs){
+            num_jobs = t.events[i].job + 1;
+        }
+    }
+    int64_t *command_of = malloc(sizeof(int64_t) * (num_jobs > 0 ? num_jobs : 1));
+    for (uint32_t j=0; j<num_jobs; j++){
+        command_of[j] = -1;
+    }
+    for (uint64_t i=0; i<num_events; i++){
+        if (t.events[i].kind == TRACE_ARRIVAL){
+            command_of[t.events[i].job] = t.events[i].value;
+        }
+    }
+
+    ReplayJob *jobs = malloc(sizeof(ReplayJob) * (num_jobs > 0 ? num_jobs : 1));
+    uint32_t num_completed = 0;
+    if (csv != NULL){
+        fprintf(csv, RESULT_CSV_HEADER);
+    }
+    Process p = {0};
+    int64_t time = 0;
+    for (uint64_t i=0; i<num_events; i++){
+        TraceEvent *e = &t.events[i];
+        time += e->time_delta;
+        const char *command = command_of[e->job] >= 0 ? trace_command(&t, command_of[e->job]) : "?";
+        switch (e->kind){
+        case TRACE_SLICE:
+            if (switches != NULL){
+                p.command = (char *)command;
+                context_switch_output_to(switches, &p, time, time + e->value);
+            }
+            break;
+        case TRACE_ARRIVAL:
+            p.arrival_time = time;
+            break;
+        case TRACE_START:
+            p.start_time = time;
+            p.cpu_time = e->value;
+            break;
+        case TRACE_EXIT:
+            // the same arithmetic as the schedulers
+            p.command = (char *)command;
+            p.finished = e->flags & TRACE_FINISHED;
+            p.error = e->flags & TRACE_ERROR;
+            p.completion_time = time;
+            p.burst_time = e->value;
+            p.response_time = p.start_time - p.arrival_time;
+            p.turnaround_time = p.completion_time - p.arrival_time;
+            p.waiting_time = p.turnaround_time - p.burst_time;
+            if (csv != NULL){
+                print_result(csv, &p);
+            }
+            jobs[num_completed++] = (ReplayJob){p.arrival_time, p.burst_time, e->job, command_of[e->job]};
+            break;
+        }
+    }
+
+    if (workload != NULL){
+        qsort(jobs, num_completed, sizeof(ReplayJob), compare_replay_jobs);
+        for (uint32_t j=0; j<num_completed; j++){
+            fprintf(workload, "%lu,%lu,%s\n", jobs[j].arrival_time, jobs[j].burst_time, trace_command(&t, jobs[j].command_id));
+        }
+    }
+
+    if (csv != NULL && csv != stdout) fclose(csv);
+    if (switches != NULL) fclose(switches);
+    if (workload != NULL) fclose(workload);
+    free(command_of);
+    free(jobs);
+    trace_close(&t);
+    return 0;
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_MAGIC "PSTRACE"
+#define TRACE_VERSION 1
+
+enum { TRACE_SLICE, TRACE_ARRIVAL, TRACE_START, TRACE_EXIT };
+enum { TRACE_FINISHED = 1, TRACE_ERROR = 2 };
+
+
+/*
+Binary trace of a scheduler run: a header, fixed-width events, then the table of commands.
+Every event carries the job it belongs to and its time as a delta from the previous event, a
+completed job is described by an ARRIVAL, a START and an EXIT event, and every slice it ran by a
+SLICE event. Together they give back the exact result rows and context switch lines of the run.
+The file is meant to be mapped: the header gives the offsets of both arrays.
+*/
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint64_t num_events;
+    uint64_t num_commands;
+    uint64_t events_offset;
+    uint64_t commands_offset;    // num_commands offsets of the strings, relative to the table, then the strings
+    uint64_t reserved[2];
+} TraceHeader;
+
+
+typedef struct {
+    uint8_t kind;
+    uint8_t flags;    // EXIT: TRACE_FINISHED, TRACE_ERROR
+    uint16_t reserved;
+    uint32_t job;
+    int32_t time_delta;    // ms since the time of the previous event
+    uint32_t value;    // SLICE: duration, ARRIVAL: command id, START: cpu time, EXIT: burst time
+} TraceEvent;
+
+
+/* Command strings of a trace, interned into ids in order of first appearance */
+typedef struct {
+    char **commands;    // by id
+    uint32_t num_commands;
+    uint32_t *slots;    // open addressing table of id + 1, 0 for an empty slot
+    uint32_t num_slots;    // power of two, at least twice num_commands
+} TraceCommands;
+
+
+/* Records events into a trace file, commands are interned into ids */
+typedef struct {
+    FILE *file;
+    TraceCommands commands;
+    uint64_t num_events;
+    int64_t last_time;
+} TraceRecorder;
+
+
+/* Maps a trace file for reading */
+typedef struct {
+    TraceHeader *header;
+    size_t size;
+    TraceEvent *events;
+    uint64_t *command_offsets;
+} TraceReader;
+
+
+// file that every scheduler run records its trace into, NULL to not record
+static const char *trace_record_path = NULL;
+
+
+/* FNV-1a hash of a command */
+uint64_t trace_hash(const char *command){
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c=(const unsigned char *)command; *c; c++){
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+void trace_commands_init(TraceCommands *c){
+    c->num_commands = 0;
+    c->num_slots = 64;
+    c->slots = calloc(c->num_slots, sizeof(uint32_t));
+    c->commands = malloc(sizeof(char *) * c->num_slots / 2);
+}
+
+
+/* Slot of the command in the table, the empty slot it would go into if it is not there */
+uint32_t trace_commands_slot(TraceCommands *c, const char *command, uint64_t hash){
+    uint32_t mask = c->num_slots - 1;
+    uint32_t i = hash & mask;
+    while (c->slots[i] != 0 && strcmp(c->commands[c->slots[i] - 1], command) != 0){
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+
+/* Id of the command, a new one if it was not seen before */
+uint32_t trace_commands_intern(TraceCommands *c, const char *command){
+    uint32_t i = trace_commands_slot(c, command, trace_hash(command));
+    if (c->slots[i] != 0){
+        return c->slots[i] - 1;
+    }
+    if ((c->num_commands + 1) * 2 > c->num_slots){
+        // double the table and put the commands back in
+        free(c->slots);
+        c->num_slots *= 2;
+        c->slots = calloc(c->num_slots, sizeof(uint32_t));
+        c->commands = realloc(c->commands, sizeof(char *) * c->num_slots / 2);
+        for (uint32_t id=0; id<c->num_commands; id++){
+            c->slots[trace_commands_slot(c, c->commands[id], trace_hash(c->commands[id]))] = id + 1;
+        }
+        i = trace_commands_slot(c, command, trace_hash(command));
+    }
+    c->commands[c->num_commands] = strdup(command);
+    c->slots[i] = c->num_commands + 1;
+    return c->num_commands++;
+}
+
+
+void trace_commands_free(TraceCommands *c){
+    for (uint32_t id=0; id<c->num_commands; id++){
+        free(c->commands[id]);
+    }
+    free(c->commands);
+    free(c->slots);
+}
+
+
+/* Create the trace file, returns false if it cannot be written */
+bool trace_recorder_open(TraceRecorder *r, const char *path){
+    r->file = fopen(path, "w");
+    if (r->file == NULL){
+        return false;
+    }
+    // the header is written with the final counts when the recorder is closed
+    TraceHeader header = {0};
+    fwrite(&header, sizeof(header), 1, r->file);
+    trace_commands_init(&r->commands);
+    r->num_events = 0;
+    r->last_time = 0;
+    return true;
+}
+
+
+void trace_record(TraceRecorder *r, int kind, int flags, uint32_t job, uint64_t time, uint64_t value){
+    TraceEvent e = {
+        .kind = kind,
+        .flags = flags,
+        .job = job,
+        .time_delta = (int32_t)((int64_t)time - r->last_time),
+        .value = value > UINT32_MAX ? UINT32_MAX : (uint32_t)value
+    };
+    r->last_time = time;
+    fwrite(&e, sizeof(e), 1, r->file);
+    r->num_events++;
+}
+
+
+/* Record a slice a job ran for */
+void trace_record_slice(TraceRecorder *r, uint32_t job, uint64_t start_time, uint64_t end_time){
+    trace_record(r, TRACE_SLICE, 0, job, start_time, end_time - start_time);
+}
+
+
+/*
+Record the completion of a job
+Input:
+    TraceRecorder *r: the recorder
+    uint32_t job: id of the job
+    const char *command: its command
+    uint64_t arrival_time, start_time, completion_time: times of the job
+    uint64_t burst_time, cpu_time: time it ran and cpu time it used
+    bool finished, error: how it exited
+*/
+void trace_record_exit(TraceRecorder *r, uint32_t job, const char *command, uint64_t arrival_time, uint64_t start_time,
+        uint64_t completion_time, uint64_t burst_time, uint64_t cpu_time, bool finished, bool error){
+    uint32_t command_id = trace_commands_intern(&r->commands, command);
+    trace_record(r, TRACE_ARRIVAL, 0, job, arrival_time, command_id);
+    trace_record(r, TRACE_START, 0, job, start_time, cpu_time);
+    trace_record(r, TRACE_EXIT, (finished ? TRACE_FINISHED : 0) | (error ? TRACE_ERROR : 0), job, completion_time, burst_time);
+}
+
+
+/* Write the command table and the header and close the file */
+void trace_recorder_close(TraceRecorder *r){
+    TraceHeader header = {0};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.event_size = sizeof(TraceEvent);
+    header.num_events = r->num_events;
+    header.num_commands = r->commands.num_commands;
+    header.events_offset = sizeof(TraceHeader);
+    header.commands_offset = sizeof(TraceHeader) + r->num_events * sizeof(TraceEvent);
+
+    uint64_t offset = header.num_commands * sizeof(uint64_t);
+    for (uint64_t i=0; i<header.num_commands; i++){
+        fwrite(&offset, sizeof(offset), 1, r->file);
+        offset += strlen(r->commands.commands[i]) + 1;
+    }
+    for (uint64_t i=0; i<header.num_commands; i++){
+        fwrite(r->commands.commands[i], strlen(r->commands.commands[i]) + 1, 1, r->file);
+    }
+    fseek(r->file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, r->file);
+    fclose(r->file);
+    trace_commands_free(&r->commands);
+}
+
+
+/*
+Check that every array and string of a mapped trace lies inside the mapping, and that every ARRIVAL
+refers to a command of the table. The counts come from the file, so the sizes are compared by
+division, which cannot overflow.
+*/
+bool trace_valid(TraceReader *t){
+    TraceHeader *h = t->header;
+    if (memcmp(h->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || h->version != TRACE_VERSION
+            || h->event_size != sizeof(TraceEvent)){
+        return false;
+    }
+    if (h->events_offset < sizeof(TraceHeader) || h->events_offset > t->size || h->events_offset % sizeof(uint32_t) != 0
+            || h->num_events > (t->size - h->events_offset) / sizeof(TraceEvent)){
+        return false;
+    }
+    if (h->commands_offset < sizeof(TraceHeader) || h->commands_offset > t->size || h->commands_offset % sizeof(uint64_t) != 0
+            || h->num_commands > (t->size - h->commands_offset) / sizeof(uint64_t)){
+        return false;
+    }
+    // every string starts after the offsets and ends with a NUL inside the table
+    const char *table = (const char *)h + h->commands_offset;
+    uint64_t table_size = t->size - h->commands_offset;
+    const uint64_t *offsets = (const uint64_t *)table;
+    for (uint64_t i=0; i<h->num_commands; i++){
+        if (offsets[i] < h->num_commands * sizeof(uint64_t) || offsets[i] >= table_size
+                || memchr(table + offsets[i], '\0', table_size - offsets[i]) == NULL){
+            return false;
+        }
+    }
+    const TraceEvent *events = (const TraceEvent *)((const char *)h + h->events_offset);
+    for (uint64_t i=0; i<h->num_events; i++){
+        if (events[i].kind == TRACE_ARRIVAL && events[i].value >= h->num_commands){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/* Map a trace for reading, returns false if the file is missing or not a complete and valid trace */
+bool trace_open(TraceReader *t, const char *path){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0){
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TraceHeader)){
+        close(fd);
+        return false;
+    }
+    t->size = st.st_size;
+    t->header = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (t->header == MAP_FAILED){
+        return false;
+    }
+    if (!trace_valid(t)){
+        munmap(t->header, t->size);
+        return false;
+    }
+    TraceHeader *h = t->header;
+    t->events = (TraceEvent *)((char *)h + h->events_offset);
+    t->command_offsets = (uint64_t *)((char *)h + h->commands_offset);
+    return true;
+}
+
+
+/* Command string of the given command id */
+const char *trace_command(TraceReader *t, uint32_t id){
+    return (const char *)t->command_offsets + t->command_offsets[id];
+}
+
+
+void trace_close(TraceReader *t){
+    munmap(t->header, t->size);
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include <time.h>
 #include <sys/time.h>
@@ -12,11 +17,30 @@
 #include <fcntl.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "slab.h"
+#include "trace.h"
+#include "job_cgroup.h"
+#include "job_output.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define RESULT_CSV_HEADER "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time,CPU Time\n"
 
 
 typedef struct {
     char *command;
     int process_id;
+    int pidfd;
     bool started;
     bool finished;
     bool error;
@@ -27,37 +51,43 @@ typedef struct {
     uint64_t waiting_time;
     uint64_t completion_time;
     uint64_t turnaround_time;
+    uint64_t cpu_time;    // user + system cpu time used by the process, excludes time blocked or runnable
+    char **args;    // argv of the command, tokenized before the process starts and freed once it is spawned
     int history_idx;
+    uint32_t job_id;    // position of the process in the input, identifies it in traces
+    JobCgroup *cgroup;    // cgroup the process and its descendants run in, NULL when sliced with signals
 } Process;
 
 
-/* Get the current time in milliseconds relative to the start_time */
+/* Get the current time in milliseconds relative to the start_time, from the monotonic clock */
 uint64_t ms_time(uint64_t start_time){
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000 - start_time;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000 - start_time;
 }
 
 
 /*
-Get array of args from the given command character array
+Split the command into an array of args at spaces. The array and the strings it points to
+are a single slab allocation, released with one slab_free.
 Input:
-    char *command: command character array
+    const char *command: command character array
 Output:
-    char **: array of arguments
+    char **: NULL terminated array of arguments
 */
-char **get_args_from_command(char *command){
-    int args_size = 4;
-    char **args = malloc(args_size * sizeof(char *));
+char **tokenize_command(const char *command){
+    size_t len = strlen(command);
+    // a command of len characters has at most len / 2 + 1 arguments
+    size_t max_args = len / 2 + 2;
+    char **args = slab_alloc(max_args * sizeof(char *) + len + 1);
+    char *copy = (char *)(args + max_args);
+    memcpy(copy, command, len + 1);
     int j = 0;
-    char *token = strtok(strdup(command), " ");
+    char *saveptr;
+    char *token = strtok_r(copy, " ", &saveptr);
     while (token != NULL){
-        if (j >= args_size){
-            args_size *= 2;
-            args = realloc(args, args_size * sizeof(char *));
-        }
         args[j++] = token;
-        token = strtok(NULL, " ");
+        token = strtok_r(NULL, " ", &saveptr);
     }
     args[j] = NULL;
     return args;
@@ -65,129 +95,545 @@ char **get_args_from_command(char *command){
 
 
 /*
-Create a child process to execute the given command
+Create a child process to execute the given command.
+posix_spawnp shares the address space with the child until it execs instead of copying the page
+tables of the scheduler, so the cost of a start does not grow with the memory of the scheduler.
+With job_output_dir set, the stdout and stderr of the command go to its logs instead of the scheduler's.
 Input:
-    Process *p: pointer to the process
+    Process *p: pointer to the process, its args are tokenized here if that was not done at enqueue
     uint64_t start_time: start time of the scheduler
 */
 void start_process(Process *p, uint64_t start_time){
     p->started = true;
     p->start_time = ms_time(start_time);
     p->response_time = p->start_time - p->arrival_time;
-    int pid = fork();
-    if (pid == 0) {
-        char **args = get_args_from_command(p->command);
-        execvp(args[0], args);
-        exit(1);
-    } else if (pid < 0) {
+    if (p->args == NULL){
+        p->args = tokenize_command(p->command);
+    }
+    pid_t pid;
+    // a command that cannot be executed fails here, as a failed exec in the child would
+    int res = ENOENT;
+    if (p->args[0] != NULL){
+        posix_spawn_file_actions_t actions;
+        int output_fds[2] = {-1, -1};
+        bool captured = job_output_open(p->job_id, &actions, output_fds);
+        p->cgroup = cgroup_create();
+        res = p->cgroup != NULL ? cgroup_spawn(p->cgroup, &pid, p->args, captured ? output_fds : NULL) : -1;
+        if (res != 0 && p->cgroup != NULL){
+            cgroup_destroy(p->cgroup);
+            p->cgroup = NULL;
+        }
+        if (res == -1){
+            res = posix_spawnp(&pid, p->args[0], captured ? &actions : NULL, NULL, p->args, environ);
+        }
+        if (captured){
+            job_output_spawned(&actions, output_fds);
+        }
+    }
+    slab_free(p->args);
+    p->args = NULL;
+    if (res != 0) {
         p->error = true;
+        p->pidfd = -1;
         p->completion_time = ms_time(start_time);
     } else {
         p->process_id = pid;
+        // pidfd becomes readable when the child exits, -1 if the kernel does not support it
+        p->pidfd = syscall(SYS_pidfd_open, pid, 0);
     }
 }
 
+
 /*
-Print the output after every context switch
+Record the exit status of a reaped process and release its pidfd and cgroup
 Input:
     Process *p: pointer to the process
-    uint64_t start_time: start time of the context
-    uint64_t end_time: end time of the context
+    int status: status returned by waitpid
+    uint64_t start_time: start time of the scheduler
 */
-void context_switch_output(Process *p, uint64_t start_time, uint64_t end_time){
-    printf("%s|%lu|%lu\n", p->command, start_time, end_time);
+void finish_process(Process *p, int status, uint64_t start_time){
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 1){
+        p->error = true;
+    } else {
+        p->finished = true;
+    }
+    p->completion_time = ms_time(start_time);
+    if (p->pidfd >= 0){
+        close(p->pidfd);
+        p->pidfd = -1;
+    }
+    if (p->cgroup != NULL){
+        // the cgroup also accounts the processes the command forked
+        uint64_t cpu_time = cgroup_cpu_time(p->cgroup);
+        if (cpu_time > p->cpu_time){
+            p->cpu_time = cpu_time;
+        }
+        cgroup_destroy(p->cgroup);
+        p->cgroup = NULL;
+    }
 }
 
 
 /*
-Run the given process completely
+Reap the process if it has exited and record its exit status and cpu time
 Input:
     Process *p: pointer to the process
+    int options: options of wait4, WNOHANG to return immediately if the process is still running
     uint64_t start_time: start time of the scheduler
+Output:
+    pid of the reaped process, 0 if it is still running, -1 on error
 */
-void run_process_completely(Process *p, uint64_t start_time, FILE *file){
-    uint64_t context_start_time = ms_time(start_time);
-    start_process(p, start_time);
+int reap_process(Process *p, int options, uint64_t start_time){
     int status;
-    waitpid(p->process_id, &status, 0);
-    if (WIFEXITED(status) && WEXITSTATUS(status) == 1){
-        p->error = true;
+    struct rusage usage;
+    int res = wait4(p->process_id, &status, options, &usage);
+    if (res > 0){
+        p->cpu_time = usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000
+            + usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+        finish_process(p, status, start_time);
+    }
+    return res;
+}
+
+
+/*
+Read the cpu time a live process has used so far, in milliseconds.
+Uses the cpu.stat of its cgroup, which includes its descendants, under the cgroup backend,
+otherwise the cpu clock of the process, or /proc/<pid>/stat (clock tick resolution) if that is unavailable.
+Input:
+    Process *p: pointer to the process, must not be reaped yet
+Output:
+    cpu time of the process, the last known value if it cannot be read
+*/
+uint64_t process_cpu_time(Process *p){
+    if (p->cgroup != NULL){
+        return cgroup_cpu_time(p->cgroup);
+    }
+    clockid_t clock;
+    struct timespec ts;
+    if (clock_getcpuclockid(p->process_id, &clock) == 0 && clock_gettime(clock, &ts) == 0){
+        return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", p->process_id);
+    FILE *stat = fopen(path, "r");
+    if (stat == NULL){
+        return p->cpu_time;
+    }
+    char line[1024];
+    uint64_t cpu_time = p->cpu_time;
+    unsigned long utime, stime;
+    // the command name may contain spaces, fields are counted from its closing parenthesis
+    if (fgets(line, sizeof(line), stat) != NULL){
+        char *fields = strrchr(line, ')');
+        if (fields != NULL && sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2){
+            cpu_time = (utime + stime) * 1000 / sysconf(_SC_CLK_TCK);
+        }
+    }
+    fclose(stat);
+    return cpu_time;
+}
+
+
+/* Stop a started process, together with every process it forked under the cgroup backend */
+void pause_process(Process *p){
+    if (p->cgroup != NULL){
+        cgroup_freeze(p->cgroup, true);
     } else {
-        p->finished = true;
+        kill(p->process_id, SIGSTOP);
     }
-    p->completion_time = ms_time(start_time);
-    p->burst_time = p->completion_time - p->start_time;
-    p->turnaround_time = p->completion_time - p->arrival_time;
-    p->waiting_time = p->turnaround_time - p->burst_time;
+}
+
 
+/* Let a process stopped by pause_process run again */
+void resume_process(Process *p){
+    if (p->cgroup != NULL){
+        cgroup_freeze(p->cgroup, false);
+    } else {
+        kill(p->process_id, SIGCONT);
+    }
+}
+
+
+/* Format the metrics of a completed process as a row of the result csv */
+void print_result(FILE *file, Process *p){
     fprintf(
-        file, "%s,%s,%s,%lu,%lu,%lu,%lu\n",
+        file, "%s,%s,%s,%lu,%lu,%lu,%lu,%lu\n",
         p->command,
         p->finished ? "Yes" : "No",
         p->error ? "Yes" : "No",
         p->burst_time,
         p->turnaround_time,
         p->waiting_time,
-        p->response_time
+        p->response_time,
+        p->cpu_time
     );
-    fflush(file);
+}
+
+
+// epoll instance and timerfd reused by every slice run on this thread
+static __thread int slice_epoll_fd = -1;
+static __thread int slice_timer_fd = -1;
+
+
+/* Create the epoll instance and slice timer of the calling thread, returns false on failure */
+bool init_slice_waiter(){
+    if (slice_epoll_fd >= 0){
+        return true;
+    }
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0){
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        return false;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = timer_fd};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) < 0){
+        close(epoll_fd);
+        close(timer_fd);
+        return false;
+    }
+    slice_epoll_fd = epoll_fd;
+    slice_timer_fd = timer_fd;
+    return true;
+}
+
+
+/*
+Block until the given process exits, the time slice expires or wake_fd becomes readable.
+Falls back to sleeping for the whole slice (or polling wake_fd) if pidfd or epoll is unavailable.
+Input:
+    Process *p: pointer to the running process
+    int quantum: time slice in milliseconds, negative for no time limit
+    int wake_fd: extra file descriptor that ends the wait when readable, -1 for none
+*/
+void wait_for_slice(Process *p, int quantum, int wake_fd){
+    if (p->pidfd < 0 || !init_slice_waiter()){
+        if (wake_fd >= 0){
+            struct pollfd pfd = {.fd = wake_fd, .events = POLLIN};
+            poll(&pfd, 1, quantum >= 0 ? quantum : 10);
+        } else {
+            usleep((quantum >= 0 ? quantum : 10)*1000);
+        }
+        return;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = p->pidfd};
+    if (epoll_ctl(slice_epoll_fd, EPOLL_CTL_ADD, p->pidfd, &ev) < 0){
+        usleep((quantum >= 0 ? quantum : 10)*1000);
+        return;
+    }
+    if (wake_fd >= 0){
+        struct epoll_event wake_ev = {.events = EPOLLIN, .data.fd = wake_fd};
+        epoll_ctl(slice_epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_ev);
+    }
+
+    // arming the timer also resets any expiration left over from the previous slice
+    struct itimerspec its = {0};
+    if (quantum >= 0){
+        its.it_value.tv_sec = quantum / 1000;
+        its.it_value.tv_nsec = (long)(quantum % 1000) * 1000000;
+        if (quantum == 0){
+            its.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(slice_timer_fd, 0, &its, NULL);
+
+    int res;
+    do {
+        res = epoll_wait(slice_epoll_fd, &ev, 1, -1);
+    } while (res < 0 && errno == EINTR);
+
+    epoll_ctl(slice_epoll_fd, EPOLL_CTL_DEL, p->pidfd, NULL);
+    if (wake_fd >= 0){
+        epoll_ctl(slice_epoll_fd, EPOLL_CTL_DEL, wake_fd, NULL);
+    }
+}
 
-    context_switch_output(p, context_start_time, p->completion_time);
+
+/* Print a context switch line to the given stream */
+void context_switch_output_to(FILE *stream, Process *p, uint64_t start_time, uint64_t end_time){
+    fprintf(stream, "%s|%lu|%lu\n", p->command, start_time, end_time);
+}
+
+
+#ifndef WRITER_RING_SIZE
+#define WRITER_RING_SIZE 4096
+#endif
+#ifndef WRITER_FLUSH_INTERVAL_MS
+#define WRITER_FLUSH_INTERVAL_MS 10
+#endif
+#define WRITER_INLINE_COMMAND 96
+
+enum { WRITER_RESULT, WRITER_CONTEXT_SWITCH };
+
+
+/* A result row or context switch line waiting to be written */
+typedef struct {
+    uint64_t seq;    // ring position the cell is ready for, see ResultWriter
+    int kind;
+    Process p;    // copy of the metrics, p.command is NULL when the command is stored inline
+    uint64_t start_time;
+    uint64_t end_time;
+    char command[WRITER_INLINE_COMMAND];
+} WriterRecord;
+
+
+/*
+Writes the result rows and context switch lines on a background thread, off the scheduling path.
+Schedulers push fixed-size records into a bounded ring (Vyukov's bounded queue: every cell carries
+the position it is ready for, so any number of scheduler threads can push without a lock). The
+writer thread wakes up every WRITER_FLUSH_INTERVAL_MS, formats everything pushed so far and flushes
+the streams once per batch, so a line reaches its file at most one interval after it was pushed.
+A nearly full ring wakes the writer early, and a full one makes the scheduler wait for it.
+*/
+typedef struct {
+    WriterRecord *cells;
+    uint64_t mask;
+    uint64_t enqueue_pos;    // next position to push, shared by the scheduler threads
+    uint64_t dequeue_pos;    // next position to write, owned by the writer thread
+    FILE *file;     // result csv
+    FILE *trace;    // context switch lines
+    int event_fd;
+    bool stop;
+    bool recording;    // the writer thread also records a binary trace, see trace_record_path
+    TraceRecorder recorder;
+    pthread_t thread;
+} ResultWriter;
+
+
+/* Format the records pushed so far, returns the number written */
+uint64_t writer_drain(ResultWriter *w){
+    uint64_t written = 0;
+    while (1){
+        WriterRecord *r = &w->cells[w->dequeue_pos & w->mask];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != w->dequeue_pos + 1){
+            break;
+        }
+        bool owned = r->p.command != NULL;
+        if (!owned){
+            r->p.command = r->command;
+        }
+        Process *p = &r->p;
+        if (r->kind == WRITER_RESULT){
+            print_result(w->file, p);
+            if (w->recording){
+                trace_record_exit(&w->recorder, p->job_id, p->command, p->arrival_time, p->start_time,
+                    p->completion_time, p->burst_time, p->cpu_time, p->finished, p->error);
+            }
+        } else {
+            context_switch_output_to(w->trace, p, r->start_time, r->end_time);
+            if (w->recording){
+                trace_record_slice(&w->recorder, p->job_id, r->start_time, r->end_time);
+            }
+        }
+        if (owned){
+            free(r->p.command);
+        }
+        // hand the cell back to the producers for the next round of the ring
+        __atomic_store_n(&r->seq, w->dequeue_pos + w->mask + 1, __ATOMIC_RELEASE);
+        w->dequeue_pos++;
+        written++;
+    }
+    return written;
+}
+
+
+/* Writer thread: write a batch every interval, or earlier when the ring fills up */
+void *writer_loop(void *arg){
+    ResultWriter *w = arg;
+    struct pollfd pfd = {.fd = w->event_fd, .events = POLLIN};
+    while (1){
+        bool stopping = __atomic_load_n(&w->stop, __ATOMIC_ACQUIRE);
+        if (writer_drain(w) > 0){
+            fflush(w->file);
+            fflush(w->trace);
+        }
+        if (stopping){
+            break;
+        }
+        if (poll(&pfd, 1, WRITER_FLUSH_INTERVAL_MS) > 0){
+            uint64_t count;
+            read(w->event_fd, &count, sizeof(count));
+        }
+    }
+    return NULL;
+}
+
+
+/*
+Start the writer thread
+Input:
+    ResultWriter *w: writer to initialise
+    FILE *file: result csv, written by the writer thread until writer_stop
+    FILE *trace: destination of the context switch lines
+*/
+void writer_start(ResultWriter *w, FILE *file, FILE *trace){
+    w->cells = malloc(sizeof(WriterRecord) * WRITER_RING_SIZE);
+    w->mask = WRITER_RING_SIZE - 1;
+    for (uint64_t i=0; i<WRITER_RING_SIZE; i++){
+        w->cells[i].seq = i;
+    }
+    w->enqueue_pos = 0;
+    w->dequeue_pos = 0;
+    w->file = file;
+    w->trace = trace;
+    w->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    w->stop = false;
+    w->recording = trace_record_path != NULL && trace_recorder_open(&w->recorder, trace_record_path);
+    pthread_create(&w->thread, NULL, writer_loop, w);
+}
+
+
+/* Claim a cell of the ring, waiting for the writer if the ring is full */
+WriterRecord *writer_claim(ResultWriter *w){
+    uint64_t one = 1;
+    uint64_t pos = __atomic_load_n(&w->enqueue_pos, __ATOMIC_RELAXED);
+    while (1){
+        WriterRecord *r = &w->cells[pos & w->mask];
+        int64_t diff = (int64_t)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0){
+            if (__atomic_compare_exchange_n(&w->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                // wake the writer early once a quarter of the ring is in use
+                if ((pos & (w->mask >> 2)) == 0 && pos > 0){
+                    write(w->event_fd, &one, sizeof(one));
+                }
+                return r;
+            }
+        } else if (diff < 0){
+            // the ring is full
+            write(w->event_fd, &one, sizeof(one));
+            sched_yield();
+            pos = __atomic_load_n(&w->enqueue_pos, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&w->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+/* Fill a claimed cell with a copy of the process and publish it to the writer */
+void writer_publish(WriterRecord *r, int kind, Process *p, uint64_t start_time, uint64_t end_time){
+    uint64_t pos = r->seq;
+    r->kind = kind;
+    r->p = *p;
+    r->start_time = start_time;
+    r->end_time = end_time;
+    // online commands are freed once the process completes, the record keeps its own copy
+    size_t len = strlen(p->command);
+    if (len < WRITER_INLINE_COMMAND){
+        memcpy(r->command, p->command, len + 1);
+        r->p.command = NULL;
+    } else {
+        r->p.command = strdup(p->command);
+    }
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+
+/* Queue the metrics of a completed process as a row of the result csv */
+void write_result(ResultWriter *w, Process *p){
+    writer_publish(writer_claim(w), WRITER_RESULT, p, 0, 0);
+}
+
+
+/*
+Queue the output of a context switch
+Input:
+    ResultWriter *w: the writer
+    Process *p: pointer to the process
+    uint64_t start_time: start time of the context
+    uint64_t end_time: end time of the context
+*/
+void context_switch_output(ResultWriter *w, Process *p, uint64_t start_time, uint64_t end_time){
+    writer_publish(writer_claim(w), WRITER_CONTEXT_SWITCH, p, start_time, end_time);
+}
+
+
+/* Write everything queued so far, flush the streams and stop the writer thread */
+void writer_stop(ResultWriter *w){
+    __atomic_store_n(&w->stop, true, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    write(w->event_fd, &one, sizeof(one));
+    pthread_join(w->thread, NULL);
+    if (w->recording){
+        trace_recorder_close(&w->recorder);
+    }
+    close(w->event_fd);
+    free(w->cells);
+}
+
+
+/*
+Run the given process completely
+Input:
+    Process *p: pointer to the process
+    uint64_t start_time: start time of the scheduler
+    ResultWriter *writer: destination of the result row and context switch line
+*/
+void run_process_completely(Process *p, uint64_t start_time, ResultWriter *writer){
+    uint64_t context_start_time = ms_time(start_time);
+    start_process(p, start_time);
+    if (!p->error){
+        reap_process(p, 0, start_time);
+    }
+    p->burst_time = p->completion_time - p->start_time;
+    p->turnaround_time = p->completion_time - p->arrival_time;
+    p->waiting_time = p->turnaround_time - p->burst_time;
+
+    write_result(writer, p);
+
+    context_switch_output(writer, p, context_start_time, p->completion_time);
 };
 
 
 /* 
-Run the given process for the given time slice
+Run the given process for the given time slice. The slice ends early if the process exits,
+and the process is charged only for the time it actually ran.
 Input:
     Process *p: pointer to the process
     int quantum: time slice in milliseconds
     uint64_t start_time: start time of the scheduler
+    ResultWriter *writer: destination of the result row and context switch line
 Output:
     -1 if process has already finished or errored
     0 if process finished or errored during the time slice
     1 if process used up the entire time slice
 */
-int run_process_for_quantum(Process *p, int quantum, uint64_t start_time, FILE *file){
+int run_process_for_quantum(Process *p, int quantum, uint64_t start_time, ResultWriter *writer){
     uint64_t context_start_time = ms_time(start_time);
     if (p->error || p->finished) {
         return -1;
     } else if (!p->started) {
         start_process(p, start_time);
+        if (p->error){
+            p->turnaround_time = p->completion_time - p->arrival_time;
+            p->waiting_time = p->turnaround_time - p->burst_time;
+            write_result(writer, p);
+            context_switch_output(writer, p, context_start_time, p->completion_time);
+            return 0;
+        }
     } else {
-        kill(p->process_id, SIGCONT);
+        resume_process(p);
     }
 
-    usleep(quantum*1000);
-    p->burst_time += quantum;
-    int status;
-    int res = waitpid(p->process_id, &status, WNOHANG);
+    wait_for_slice(p, quantum, -1);
+    p->burst_time += ms_time(start_time) - context_start_time;
+    int res = reap_process(p, WNOHANG, start_time);
     int ret = 1;
     if (res > 0){
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 1){
-            p->error = true;
-        } else {
-            p->finished = true;
-        }
-        p->completion_time = ms_time(start_time);
         p->turnaround_time = p->completion_time - p->arrival_time;
         p->waiting_time = p->turnaround_time - p->burst_time;
-        fprintf(
-            file, "%s,%s,%s,%lu,%lu,%lu,%lu\n",
-            p->command,
-            p->finished ? "Yes" : "No",
-            p->error ? "Yes" : "No",
-            p->burst_time,
-            p->turnaround_time,
-            p->waiting_time,
-            p->response_time
-        );
-        fflush(file);
+        write_result(writer, p);
         ret = 0;
     } else if (res == 0){
-        kill(p->process_id, SIGSTOP);
+        pause_process(p);
+        p->cpu_time = process_cpu_time(p);
     }
 
-    context_switch_output(p, context_start_time, ms_time(start_time));
+    context_switch_output(writer, p, context_start_time, ms_time(start_time));
 
     return ret;
 };